@@ -0,0 +1,346 @@
+// Benchmark suite: synthetic twiss files from 1k rows upwards, timing dataframe construction in all
+// reader modes, to_file, column and row lookups, and recording memory use. Results are written as
+// JSON so they can be compared between commits.
+//
+//   benchmarks [--rows 1000,10000,...] [--out results.json] [--label name] [--dir tmp]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "../src/multi_loader.h"
+#include "../src/position_index.h"
+#include "../src/tfs_dataframe.h"
+#include "../src/typed_dataframe.h"
+#include "synthetic.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using TfsDataFrame = tfs::dataframe<double>;
+
+/**
+ * @brief Current resident set size in kB (0 where not available)
+ */
+size_t current_rss_kb()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Peak resident set size of the process so far in kB (0 where not available)
+ */
+size_t peak_rss_kb()
+{
+#if defined(_WIN32)
+    return 0;
+#elif defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+}
+
+struct result
+{
+    std::string name;
+    size_t rows;
+    double seconds;
+    double items_per_second;
+    size_t file_bytes;
+    long rss_delta_kb;
+    size_t peak_rss_kb;
+    size_t footprint_bytes;
+};
+
+std::vector<result> results;
+
+/// lookup results go here so the compiler cannot drop the lookups
+volatile size_t sink = 0;
+
+/**
+ * @brief Best of `repeat` runs of `f`, which returns the number of items it processed
+ */
+void run(const std::string &name, size_t rows, size_t file_bytes, int repeat, const std::function<size_t()> &f)
+{
+    double best = 1e300;
+    size_t items = 0;
+    for (int r = 0; r < repeat; r++) {
+        const auto start = clock_type::now();
+        items = f();
+        const std::chrono::duration<double> elapsed = clock_type::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    results.push_back({ name, rows, best, static_cast<double>(items) / best, file_bytes, 0, peak_rss_kb(), 0 });
+    std::printf("%-28s %10zu rows  %10.4f s  %12.0f items/s\n", name.c_str(), rows, best, results.back().items_per_second);
+}
+
+/**
+ * @brief Loads `path` and records the footprint of the dataframe and how much the resident set grew
+ *
+ * The resident set only grows if the allocator cannot reuse memory freed by earlier runs, the
+ * footprint is what the columns actually hold.
+ */
+void run_memory(const std::string &name, const std::string &path, size_t rows, const tfs::read_options &options)
+{
+    const size_t before = current_rss_kb();
+    TfsDataFrame df{ path, options };
+    const size_t after = current_rss_kb();
+    results.push_back({ name,
+        rows,
+        0.0,
+        0.0,
+        0,
+        static_cast<long>(after) - static_cast<long>(before),
+        peak_rss_kb(),
+        df.memory_usage() });
+    std::printf("%-28s %10zu rows  %10zu kB footprint  %8ld kB resident growth\n",
+        name.c_str(),
+        rows,
+        results.back().footprint_bytes / 1024,
+        results.back().rss_delta_kb);
+}
+
+namespace columns {
+TFS_COLUMN(NAME, string_field);
+TFS_COLUMN(S, real_field);
+TFS_COLUMN(BETX, real_field);
+TFS_COLUMN(BETY, real_field);
+TFS_COLUMN(MUX, real_field);
+TFS_COLUMN(MUY, real_field);
+}// namespace columns
+
+/// the columns of `load/projection`, fixed at compile time
+using projection_schema = tfs::schema<columns::NAME, columns::S, columns::BETX, columns::BETY, columns::MUX, columns::MUY>;
+
+void bench_size(size_t rows, const std::string &dir)
+{
+    const std::string path = dir + "/synthetic_" + std::to_string(rows) + ".tfs";
+    tfs::bench::write_synthetic_twiss(path, rows);
+    const size_t bytes = std::filesystem::file_size(path);
+    const int repeat = rows <= 100000 ? 5 : 1;
+
+    auto load = [&path](const tfs::read_options &options) {
+        return [&path, options]() {
+            TfsDataFrame df{ path, options };
+            return df.size();
+        };
+    };
+
+    tfs::read_options options;
+    run("load/stream", rows, bytes, repeat, load(options));
+    options.memory_map = true;
+    run("load/memory_map", rows, bytes, repeat, load(options));
+    options.threads = 0;
+    run("load/parallel", rows, bytes, repeat, load(options));
+    options.threads = 1;
+    options.columns = { "NAME", "S", "BETX", "BETY", "MUX", "MUY" };
+    run("load/projection", rows, bytes, repeat, load(options));
+    run("load/typed_projection", rows, bytes, repeat, [&path]() {
+        return tfs::typed_dataframe<projection_schema>{ path }.size();
+    });
+    options.columns.clear();
+    options.compact_strings = true;
+    run("load/compact_strings", rows, bytes, repeat, load(options));
+    // load and destroy with every column in one arena, released as a whole
+    run("load/pmr_arena", rows, bytes, repeat, [&path]() {
+        std::pmr::monotonic_buffer_resource arena;
+        return tfs::pmr::dataframe<double>{ path, tfs::read_options{}, &arena }.size();
+    });
+
+    // a measurement session: many files loaded one after another or with load_files
+    const std::vector<std::string> session(8, path);
+    run("load/files_sequential", rows, bytes * session.size(), repeat, [&session]() {
+        size_t total = 0;
+        for (auto &p : session) total += TfsDataFrame{ p }.size();
+        return total;
+    });
+    run("load/files_parallel", rows, bytes * session.size(), repeat, [&session]() {
+        size_t total = 0;
+        for (auto &r : tfs::load_files<double>(session)) total += r.df.size();
+        return total;
+    });
+
+    TfsDataFrame df{ path, tfs::read_options{ "NAME" } };
+    const std::string binary = path + ".bin";
+    df.save_binary(binary);
+    run("load/binary", rows, bytes, repeat, [&binary]() { return TfsDataFrame::load_binary(binary).size(); });
+
+    const std::string out = dir + "/synthetic_out.tfs";
+    run("write/to_file", rows, bytes, repeat, [&df, &out]() {
+        df.to_file(out);
+        return df.size();
+    });
+    tfs::write_options write;
+    write.threads = 0;
+    run("write/to_file_parallel", rows, bytes, repeat, [&df, &out, &write]() {
+        df.to_file(out, write);
+        return df.size();
+    });
+
+    const auto &names = df.get_column("NAME").as_string_vector();
+    run("lookup/get_index", rows, bytes, repeat, [&df, &names]() {
+        size_t checksum = 0;
+        for (auto &n : names) checksum += df.get_index(n);
+        sink = checksum;
+        return names.size();
+    });
+    std::vector<std::string> columns = tfs::bench::synthetic_real_columns();
+    run("lookup/get_column", rows, bytes, repeat, [&df, &columns, rows]() {
+        size_t checksum = 0;
+        const size_t lookups = std::max<size_t>(rows, 100000);
+        for (size_t i = 0; i < lookups; i++) checksum += df.get_column(columns[i % columns.size()]).size();
+        sink = checksum;
+        return lookups;
+    });
+
+    // positions spread over the whole machine, the S column grows by 0.5 to 0.75 per row
+    const auto &positions = df.get_column("S").as_real_vector();
+    std::vector<double> queries(std::max<size_t>(rows, 100000));
+    for (size_t i = 0; i < queries.size(); i++) {
+        queries[i] = positions.back() * static_cast<double>((i * 7919) % 10007) / 10007.0;
+    }
+    run("lookup/lower_bound", rows, bytes, repeat, [&positions, &queries]() {
+        size_t checksum = 0;
+        for (double q : queries) {
+            checksum += static_cast<size_t>(std::lower_bound(positions.begin(), positions.end(), q) - positions.begin());
+        }
+        sink = checksum;
+        return queries.size();
+    });
+    const tfs::position_index<double> s_index(df.get_column("S"));
+    run("lookup/position_index", rows, bytes, repeat, [&s_index, &queries]() {
+        size_t checksum = 0;
+        for (size_t row : s_index.lower_bound(queries)) checksum += row;
+        sink = checksum;
+        return queries.size();
+    });
+    run("lookup/interpolate", rows, bytes, repeat, [&df, &s_index, &queries]() {
+        sink = s_index.interpolate(df.get_column("BETX"), queries).size();
+        return queries.size();
+    });
+
+    // a measurement with every other BPM of the model, aligned back to the model by NAME
+    std::vector<size_t> measured;
+    for (size_t i = 0; i < rows; i += 2) measured.push_back(i);
+    const auto measurement = df.select(measured);
+    run("join/inner", rows, bytes, repeat, [&df, &measurement]() { return df.join(measurement, "NAME").size(); });
+    tfs::join_options left_join;
+    left_join.how = tfs::join_type::left;
+    run("join/left", rows, bytes, repeat, [&df, &measurement, &left_join]() {
+        return measurement.join(df, "NAME", left_join).size();
+    });
+
+    run("aggregate/summarize", rows, bytes, repeat, [&df, &columns]() {
+        sink = df.summarize(columns, 0).size();
+        return df.size();
+    });
+    run("aggregate/summarize_by", rows, bytes, repeat, [&df, &columns]() {
+        auto groups = df.summarize_by("NAME", [](std::string_view n) { return n.substr(0, 4); }, columns, 0);
+        sink = groups.keys.size();
+        return df.size();
+    });
+
+    // the same derived column once with one temporary per operation and once fused
+    run("expression/temporaries", rows, bytes, repeat, [&df]() {
+        const auto &betx = df.get_column("BETX").as_real_vector();
+        const auto &bety = df.get_column("BETY").as_real_vector();
+        std::vector<double> diff(betx.size()), ratio(betx.size()), root(betx.size()), out(betx.size());
+        for (size_t i = 0; i < betx.size(); i++) diff[i] = betx[i] - bety[i];
+        for (size_t i = 0; i < betx.size(); i++) ratio[i] = diff[i] / bety[i];
+        for (size_t i = 0; i < betx.size(); i++) root[i] = std::sqrt(betx[i] * bety[i]);
+        for (size_t i = 0; i < betx.size(); i++) out[i] = ratio[i] + root[i];
+        sink = out.size();
+        return out.size();
+    });
+    run("expression/fused", rows, bytes, repeat, [&df]() {
+        const auto betx = df.expr("BETX");
+        const auto bety = df.expr("BETY");
+        const auto out = tfs::evaluate((betx - bety) / bety + tfs::sqrt(betx * bety));
+        sink = out.size();
+        return out.size();
+    });
+
+    run_memory("memory/stream", path, rows, tfs::read_options{});
+    tfs::read_options compact;
+    compact.compact_strings = true;
+    run_memory("memory/compact_strings", path, rows, compact);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(binary);
+    std::filesystem::remove(out);
+}
+
+void write_json(const std::string &path, const std::string &label)
+{
+    std::ofstream f(path);
+    f << "{\n  \"label\": \"" << label << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &r = results[i];
+        f << "    {\"name\": \"" << r.name << "\", \"rows\": " << r.rows << ", \"seconds\": " << r.seconds
+          << ", \"items_per_second\": " << r.items_per_second << ", \"file_bytes\": " << r.file_bytes
+          << ", \"rss_delta_kb\": " << r.rss_delta_kb << ", \"peak_rss_kb\": " << r.peak_rss_kb
+          << ", \"footprint_bytes\": " << r.footprint_bytes << "}"
+          << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+}
+
+std::vector<size_t> parse_sizes(const std::string &arg)
+{
+    std::vector<size_t> sizes;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) sizes.push_back(std::stoul(item));
+    return sizes;
+}
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> sizes = { 1000, 10000, 100000, 1000000 };
+    std::string out = "benchmark_results.json";
+    std::string label = "tfspp";
+    std::string dir = std::filesystem::temp_directory_path().string();
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--rows")
+            sizes = parse_sizes(argv[i + 1]);
+        else if (arg == "--out")
+            out = argv[i + 1];
+        else if (arg == "--label")
+            label = argv[i + 1];
+        else if (arg == "--dir")
+            dir = argv[i + 1];
+    }
+
+    for (auto rows : sizes) bench_size(rows, dir);
+    write_json(out, label);
+    std::printf("results written to %s\n", out.c_str());
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Micro-benchmark: `data_vector::convert_back` number parsing through `from_chars` vs the old
+// `strtod`/`strtol` path, on tokens formatted like the `%le` and `%d` columns of a twiss file.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/data.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template<typename F> double time_ns_per_token(const std::vector<std::string> &tokens, int repeat, F &&f)
+{
+    const auto start = clock_type::now();
+    for (int r = 0; r < repeat; r++) {
+        for (auto &t : tokens) f(std::string_view(t));
+    }
+    const std::chrono::duration<double, std::nano> elapsed = clock_type::now() - start;
+    return elapsed.count() / static_cast<double>(tokens.size() * repeat);
+}
+
+template<typename real> void bench_real(const char *label, const std::vector<std::string> &tokens, int repeat)
+{
+    std::vector<real> a;
+    std::vector<real> b;
+    a.reserve(tokens.size() * repeat);
+    b.reserve(tokens.size() * repeat);
+
+    const double t_strtod = time_ns_per_token(tokens, repeat, [&](std::string_view s) {
+        a.push_back(tfs::strto_real<real>(s));
+    });
+    const double t_from_chars = time_ns_per_token(tokens, repeat, [&](std::string_view s) {
+        b.push_back(tfs::parse_real<real>(s));
+    });
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); i++) mismatches += a[i] != b[i];
+
+    std::printf("%-16s strtod %7.2f ns/token  from_chars %7.2f ns/token  speedup %5.2fx  mismatches %zu\n",
+        label,
+        t_strtod,
+        t_from_chars,
+        t_strtod / t_from_chars,
+        mismatches);
+}
+
+void bench_int(const std::vector<std::string> &tokens, int repeat)
+{
+    std::vector<int> a;
+    std::vector<int> b;
+    a.reserve(tokens.size() * repeat);
+    b.reserve(tokens.size() * repeat);
+
+    const double t_strtol = time_ns_per_token(tokens, repeat, [&](std::string_view s) {
+        char buffer[tfs::NUMBER_BUFFER];
+        char *end;
+        a.push_back(static_cast<int>(strtol(tfs::terminated(s, buffer), &end, 10)));
+    });
+    const double t_from_chars = time_ns_per_token(tokens, repeat, [&](std::string_view s) {
+        b.push_back(tfs::parse_int(s));
+    });
+
+    std::printf("%-16s strtol %7.2f ns/token  from_chars %7.2f ns/token  speedup %5.2fx  mismatches %d\n",
+        "int",
+        t_strtol,
+        t_from_chars,
+        t_strtol / t_from_chars,
+        a != b);
+}
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+    const size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const int repeat = 5;
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> mantissa(-10.0, 10.0);
+    std::uniform_int_distribution<int> exponent(-12, 4);
+    std::uniform_int_distribution<int> ints(-100000, 100000);
+
+    std::vector<std::string> le_tokens;
+    std::vector<std::string> d_tokens;
+    le_tokens.reserve(n);
+    d_tokens.reserve(n);
+    char buffer[64];
+    for (size_t i = 0; i < n; i++) {
+        std::snprintf(buffer, sizeof(buffer), "%.17le", mantissa(rng) * std::pow(10.0, exponent(rng)));
+        le_tokens.emplace_back(buffer);
+        d_tokens.push_back(std::to_string(ints(rng)));
+    }
+
+    std::printf("%zu tokens x %d\n", n, repeat);
+    bench_real<double>("%le -> double", le_tokens, repeat);
+    bench_real<float>("%le -> float", le_tokens, repeat);
+    bench_int(d_tokens, repeat);
+    return 0;
+}
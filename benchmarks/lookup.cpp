@@ -0,0 +1,69 @@
+// Benchmark: row index and column name lookups through `tfs::hash_index` vs `std::map`, which is what
+// `dataframe` used for `idx` and `column_headers` before.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/tfs_dataframe.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template<typename F> double lookups_per_second(const std::vector<std::string> &queries, int repeat, F &&f)
+{
+    size_t checksum = 0;
+    const auto start = clock_type::now();
+    for (int r = 0; r < repeat; r++) {
+        for (auto &q : queries) checksum += f(q);
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    if (checksum == 42) std::printf(" ");// keep the loop alive
+    return static_cast<double>(queries.size() * repeat) / elapsed.count();
+}
+
+void bench(const char *label, const std::vector<std::string> &keys, int repeat)
+{
+    std::map<std::string, size_t> map;
+    for (size_t i = 0; i < keys.size(); i++) map.insert(std::make_pair(keys[i], i));
+    auto index = tfs::hash_index::build(keys.size(), [&keys](size_t i) { return std::string_view(keys[i]); });
+
+    std::vector<std::string> queries = keys;
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(42));
+
+    const double map_rate = lookups_per_second(queries, repeat, [&map](const std::string &q) { return map[q]; });
+    const double hash_rate = lookups_per_second(queries, repeat, [&index](const std::string &q) {
+        return index.find(q);
+    });
+
+    std::printf("%-28s std::map %8.2f M/s  hash_index %8.2f M/s  speedup %5.2fx\n",
+        label,
+        map_rate * 1e-6,
+        hash_rate * 1e-6,
+        hash_rate / map_rate);
+}
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+    const size_t n = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+    std::vector<std::string> bpms;
+    bpms.reserve(n);
+    for (size_t i = 0; i < n; i++) bpms.push_back("BPM." + std::to_string(i % 34) + "R" + std::to_string(i) + ".B1");
+    bench("row index (BPM names)", bpms, 10);
+
+    const std::vector<std::string> twiss_columns = { "NAME", "KEYWORD", "S", "L", "BETX", "BETY", "ALFX", "ALFY",
+        "MUX", "MUY", "DX", "DY", "DPX", "DPY", "X", "Y", "PX", "PY", "K0L", "K1L", "K2L", "K3L", "K1SL", "K2SL",
+        "R11", "R12", "R21", "R22", "ENERGY", "ANGLE", "TILT", "E1", "E2", "HGAP", "FINT", "FINTX", "APERTYPE",
+        "APER_1", "APER_2", "APER_3", "APER_4", "PARENT", "ORIGIN", "WX", "WY", "PHIX", "PHIY", "DMUX", "DMUY",
+        "DDX", "DDY", "DDPX", "DDPY", "BETA11", "BETA22", "GAMMA11", "GAMMA22", "DISP1", "DISP2", "DISP3" };
+    bench("column names (twiss)", twiss_columns, 200000);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// Synthetic twiss-like TFS files for the benchmarks: a MAD-X style header with a few dozen `@`
+// properties, unique quoted NAMEs, a low-cardinality KEYWORD column, %d columns and mostly %le.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tfs::bench {
+
+inline const std::vector<std::string> &synthetic_real_columns()
+{
+    static const std::vector<std::string> names = { "S", "L", "BETX", "BETY", "ALFX", "ALFY", "MUX", "MUY", "DX",
+        "DY", "DPX", "DPY", "X", "Y", "PX", "PY", "T", "PT", "K0L", "K1L", "K2L", "K3L", "K1SL", "K2SL", "ANGLE",
+        "TILT", "R11", "R12", "R21", "R22", "WX", "WY", "PHIX", "PHIY", "DMUX", "DMUY", "DDX", "DDY", "ENERGY",
+        "APER_1", "APER_2" };
+    return names;
+}
+
+inline const std::vector<std::string> &synthetic_int_columns()
+{
+    static const std::vector<std::string> names = { "NUMBER", "TURN", "SLOT_ID" };
+    return names;
+}
+
+/**
+ * @brief Writes a synthetic twiss file with `rows` rows to `path`
+ */
+inline void write_synthetic_twiss(const std::string &path, size_t rows, unsigned seed = 42)
+{
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr) throw std::runtime_error("could not open " + path);
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+    const char *string_properties[][2] = { { "NAME", "\"TWISS\"" }, { "TYPE", "\"TWISS\"" },
+        { "SEQUENCE", "\"LHCB1\"" }, { "PARTICLE", "\"PROTON\"" }, { "TITLE", "\"synthetic benchmark\"" },
+        { "ORIGIN", "\"5.08.01 Linux 64\"" }, { "DATE", "\"01/01/24\"" }, { "TIME", "\"12.00.00\"" } };
+    for (auto &p : string_properties) std::fprintf(f, "@ %-16s %%%02ds %s\n", p[0], (int)std::strlen(p[1]), p[1]);
+
+    const char *real_properties[] = { "MASS", "CHARGE", "ENERGY", "PC", "GAMMA", "KBUNCH", "BCURRENT", "SIGE",
+        "SIGT", "NPART", "EX", "EY", "ET", "BV_FLAG", "LENGTH", "ALFA", "ORBIT5", "GAMMATR", "Q1", "Q2", "DQ1", "DQ2",
+        "DXMAX", "DYMAX", "XCOMAX", "YCOMAX", "BETXMAX", "BETYMAX", "XCORMS", "YCORMS", "DXRMS", "DYRMS", "DELTAP",
+        "SYNCH_1", "SYNCH_2", "SYNCH_3", "SYNCH_4", "SYNCH_5", "SYNCH_6", "SYNCH_8" };
+    for (auto *p : real_properties) std::fprintf(f, "@ %-16s %%le %.15g\n", p, 100.0 * unit(rng));
+
+    const auto &reals = synthetic_real_columns();
+    const auto &ints = synthetic_int_columns();
+
+    std::fprintf(f, "* %-24s %-16s", "NAME", "KEYWORD");
+    for (auto &c : reals) std::fprintf(f, " %18s", c.c_str());
+    for (auto &c : ints) std::fprintf(f, " %10s", c.c_str());
+    std::fprintf(f, "\n$ %-24s %-16s", "%s", "%s");
+    for (size_t i = 0; i < reals.size(); i++) std::fprintf(f, " %18s", "%le");
+    for (size_t i = 0; i < ints.size(); i++) std::fprintf(f, " %10s", "%d");
+    std::fprintf(f, "\n");
+
+    const char *keywords[] = { "\"MARKER\"", "\"DRIFT\"", "\"QUADRUPOLE\"", "\"SBEND\"", "\"MONITOR\"",
+        "\"SEXTUPOLE\"", "\"HKICKER\"", "\"VKICKER\"", "\"RCOLLIMATOR\"", "\"MULTIPOLE\"" };
+    double s = 0.0;
+    char name[64];
+    for (size_t row = 0; row < rows; row++) {
+        std::snprintf(name, sizeof(name), "\"BPM.%zuR%zu.B1\"", row % 34, row);
+        std::fprintf(f, "  %-24s %-16s", name, keywords[row % 10]);
+        s += 0.5 + unit(rng) * 0.25;
+        std::fprintf(f, " % 18.10e", s);
+        for (size_t c = 1; c < reals.size(); c++) {
+            std::fprintf(f, " % 18.10e", std::pow(10.0, 3.0 * unit(rng)) * unit(rng));
+        }
+        for (size_t c = 0; c < ints.size(); c++) std::fprintf(f, " %10d", static_cast<int>(row * (c + 1) % 100000));
+        std::fprintf(f, "\n");
+    }
+    std::fclose(f);
+}
+
+}// namespace tfs::bench
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+#include "format.h"
+#include "hash_index.h"
+#include "thread_pool.h"
+
+namespace tfs {
+
+// ----------------------------------------------------------------------------------------
+// ---- Column reductions -----------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// `summarize` reduces `%le` and `%d` columns to count, sum, mean, min, max, standard deviation and
+// RMS in one pass over the data. Columns are cut into blocks of `SUMMARY_BLOCK` values that stay
+// in L1. Each block is reduced with `SUMMARY_LANES` independent accumulators, a loop the compiler
+// vectorizes, and then swept a second time for the squared deviations from its mean. The block
+// results are combined pairwise (Chan et al.), so the rounding error grows with the log of the
+// column length rather than with the length. NaN values are skipped like pandas does.
+//
+// `summarize_by` does the same per group of a string or int key column. Every thread keeps
+// compensated (Neumaier) sums of the values, shifted by the first value of the group, for its rows.
+// The per-thread results are merged the same way.
+
+/// values reduced together, small enough to stay in L1 for the second sweep
+constexpr size_t SUMMARY_BLOCK = 1024;
+/// independent accumulators per block
+constexpr size_t SUMMARY_LANES = 8;
+/// values per task when summarizing on several threads
+constexpr size_t SUMMARY_TASK = 1 << 16;
+static_assert(SUMMARY_TASK % SUMMARY_BLOCK == 0, "tasks need to start at a block boundary");
+
+/**
+ * @brief Statistics of the non-NaN values of a column
+ */
+struct summary
+{
+    size_t count = 0;
+    double sum = 0;
+    double mean = std::numeric_limits<double>::quiet_NaN();
+    double min = std::numeric_limits<double>::quiet_NaN();
+    double max = std::numeric_limits<double>::quiet_NaN();
+    /// sum of the squared deviations from `mean`
+    double m2 = 0;
+
+    /// sample variance, like pandas (`ddof=1`)
+    [[nodiscard]] auto variance() const -> double
+    {
+        return count > 1 ? m2 / static_cast<double>(count - 1) : std::numeric_limits<double>::quiet_NaN();
+    }
+    [[nodiscard]] auto stddev() const -> double { return std::sqrt(variance()); }
+    /// root mean square of the values themselves, not of their deviations
+    [[nodiscard]] auto rms() const -> double
+    {
+        return count > 0 ? std::sqrt(mean * mean + m2 / static_cast<double>(count))
+                         : std::numeric_limits<double>::quiet_NaN();
+    }
+};
+
+/**
+ * @brief Statistics of the value columns for every group of a key column
+ */
+struct grouped_summary
+{
+    /// group keys in order of their first row, `%d` keys are formatted
+    std::vector<std::string> keys;
+    std::vector<std::string> columns;
+    /// `keys.size() * columns.size()` entries, all columns of a group next to each other
+    std::vector<summary> values;
+
+    [[nodiscard]] auto at(size_t group, size_t column) const -> const summary &
+    {
+        return values[group * columns.size() + column];
+    }
+};
+
+/**
+ * @brief Statistics of the values of `a` and `b` together
+ */
+inline auto merge(const summary &a, const summary &b) -> summary
+{
+    if (a.count == 0) return b;
+    if (b.count == 0) return a;
+    summary r;
+    r.count = a.count + b.count;
+    const auto na = static_cast<double>(a.count);
+    const auto nb = static_cast<double>(b.count);
+    const auto n = static_cast<double>(r.count);
+    const double delta = b.mean - a.mean;
+    r.sum = a.sum + b.sum;
+    r.mean = a.mean + delta * nb / n;
+    r.m2 = a.m2 + b.m2 + delta * delta * na * nb / n;
+    r.min = std::min(a.min, b.min);
+    r.max = std::max(a.max, b.max);
+    return r;
+}
+
+namespace detail {
+
+    /**
+     * @brief Merges `parts` as a balanced tree
+     */
+    inline auto merge_pairwise(const summary *parts, size_t n) -> summary
+    {
+        if (n == 0) return {};
+        if (n == 1) return parts[0];
+        const size_t half = n / 2;
+        return merge(merge_pairwise(parts, half), merge_pairwise(parts + half, n - half));
+    }
+
+    template<typename T> auto summarize_block(const T *x, size_t n) -> summary
+    {
+        constexpr size_t L = SUMMARY_LANES;
+        constexpr double inf = std::numeric_limits<double>::infinity();
+        double sum[L] = {};
+        double count[L] = {};
+        double lo[L];
+        double hi[L];
+        std::fill(lo, lo + L, inf);
+        std::fill(hi, hi + L, -inf);
+
+        // NaN fails every comparison, so it drops out of the sums and never wins min or max
+        auto add = [&](size_t lane, double v) {
+            const bool valid = v == v;
+            sum[lane] += valid ? v : 0.0;
+            count[lane] += valid ? 1.0 : 0.0;
+            lo[lane] = v < lo[lane] ? v : lo[lane];
+            hi[lane] = v > hi[lane] ? v : hi[lane];
+        };
+        const size_t full = n - n % L;
+        for (size_t i = 0; i < full; i += L) {
+            for (size_t j = 0; j < L; j++) add(j, static_cast<double>(x[i + j]));
+        }
+        for (size_t i = full; i < n; i++) add(i - full, static_cast<double>(x[i]));
+
+        for (size_t width = L / 2; width > 0; width /= 2) {
+            for (size_t j = 0; j < width; j++) {
+                sum[j] += sum[j + width];
+                count[j] += count[j + width];
+                lo[j] = std::min(lo[j], lo[j + width]);
+                hi[j] = std::max(hi[j], hi[j + width]);
+            }
+        }
+
+        summary s;
+        if (count[0] == 0) return s;
+        s.count = static_cast<size_t>(count[0]);
+        s.sum = sum[0];
+        s.mean = sum[0] / count[0];
+        s.min = lo[0];
+        s.max = hi[0];
+
+        double m2[L] = {};
+        const double mean = s.mean;
+        auto deviation = [&](size_t lane, double v) {
+            const double d = v == v ? v - mean : 0.0;
+            m2[lane] += d * d;
+        };
+        for (size_t i = 0; i < full; i += L) {
+            for (size_t j = 0; j < L; j++) deviation(j, static_cast<double>(x[i + j]));
+        }
+        for (size_t i = full; i < n; i++) deviation(i - full, static_cast<double>(x[i]));
+        for (size_t j = 0; j < L; j++) s.m2 += m2[j];
+        return s;
+    }
+
+    /**
+     * @brief Reduces `n` values into one summary per `SUMMARY_BLOCK`
+     */
+    template<typename T> void summarize_blocks(const T *x, size_t n, summary *parts)
+    {
+        for (size_t begin = 0, b = 0; begin < n; begin += SUMMARY_BLOCK, b++) {
+            parts[b] = summarize_block(x + begin, std::min(SUMMARY_BLOCK, n - begin));
+        }
+    }
+
+    /**
+     * @brief Calls `f(data, n)` with the values of a `%le` or `%d` column
+     */
+    template<typename real, typename Alloc, typename F> auto visit_numeric(const data_vector<real, Alloc> &col, F &&f)
+    {
+        switch (col.type) {
+        case DataType::LE:
+            return f(col.as_real_vector().data(), col.size());
+        case DataType::D:
+            return f(col.as_int_vector().data(), col.size());
+        default:
+            throw std::runtime_error("column " + col.name + " is not numeric");
+        }
+    }
+
+    /**
+     * @brief Group number of every row of `rows` of `key` in order of first occurrence, `key_of`
+     * maps string values to their group key
+     */
+    template<typename real, typename Alloc, typename KeyOf>
+    auto group_rows(const data_vector<real, Alloc> &key, KeyOf &&key_of, row_range rows, std::vector<std::string> &keys)
+        -> std::vector<uint32_t>
+    {
+        const size_t n = rows.size();
+        std::vector<uint32_t> groups(n);
+        if (key.type == DataType::D) {
+            std::unordered_map<int, uint32_t> seen;
+            const int *values = key.as_int_vector().data() + rows.begin;
+            char buffer[FORMAT_BUFFER];
+            for (size_t i = 0; i < n; i++) {
+                const auto it = seen.try_emplace(values[i], static_cast<uint32_t>(keys.size())).first;
+                if (it->second == keys.size()) keys.emplace_back(format_int(buffer, values[i]));
+                groups[i] = it->second;
+            }
+            return groups;
+        }
+        if (key.type != DataType::S) throw std::runtime_error("column " + key.name + " cannot be grouped by");
+
+        hash_index index;
+        auto group_of = [&](std::string_view value) {
+            const std::string_view k = key_of(value);
+            const size_t g = index.find(k);
+            if (g != hash_index::npos) return static_cast<uint32_t>(g);
+            index.insert(k, keys.size());
+            keys.emplace_back(k);
+            return static_cast<uint32_t>(keys.size() - 1);
+        };
+
+        if (key.compact && key.as_string_column().is_dictionary()) {
+            // map every distinct value once, rows only look up their code
+            const auto &strings = key.as_string_column();
+            constexpr uint32_t UNSEEN = static_cast<uint32_t>(-1);
+            std::vector<uint32_t> code_group(strings.cardinality(), UNSEEN);
+            for (size_t i = 0; i < n; i++) {
+                const auto code = strings.code(rows.begin + i);
+                uint32_t &g = code_group[code];
+                if (g == UNSEEN) g = group_of(strings.dictionary_value(code));
+                groups[i] = g;
+            }
+            return groups;
+        }
+        for (size_t i = 0; i < n; i++) groups[i] = group_of(key.string_at(rows.begin + i));
+        return groups;
+    }
+
+    /**
+     * @brief Per-group accumulators of one thread, sums are shifted by the first value of the group
+     */
+    struct group_accumulator
+    {
+        double count = 0;
+        double shift = 0;
+        double sum = 0;
+        double compensation = 0;
+        double sum_sq = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+
+        void add(double v)
+        {
+            if (!(v == v)) return;
+            if (count == 0) shift = v;
+            const double d = v - shift;
+            // Neumaier summation
+            const double t = sum + d;
+            compensation += std::abs(sum) >= std::abs(d) ? (sum - t) + d : (d - t) + sum;
+            sum = t;
+            sum_sq += d * d;
+            count += 1;
+            min = std::min(min, v);
+            max = std::max(max, v);
+        }
+
+        [[nodiscard]] auto to_summary() const -> summary
+        {
+            summary s;
+            if (count == 0) return s;
+            const double shifted = sum + compensation;
+            s.count = static_cast<size_t>(count);
+            s.mean = shift + shifted / count;
+            s.sum = shift * count + shifted;
+            s.m2 = std::max(0.0, sum_sq - shifted * shifted / count);
+            s.min = min;
+            s.max = max;
+            return s;
+        }
+    };
+
+}// namespace detail
+
+/**
+ * @brief Statistics of every column of `cols`, which need to be `%le` or `%d`, over `rows`.
+ *
+ * Long columns are cut into tasks of `SUMMARY_TASK` values and all tasks of all columns share one
+ * pool of `threads` workers (`0` for one per hardware thread). The result does not depend on the
+ * number of threads.
+ */
+template<typename real, typename Alloc>
+auto summarize(const std::vector<const data_vector<real, Alloc> *> &cols, size_t threads = 1, row_range rows = {})
+    -> std::vector<summary>
+{
+    struct task
+    {
+        size_t column;
+        size_t first_block;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<std::vector<summary>> parts(cols.size());
+    std::vector<size_t> first_row(cols.size());
+    std::vector<task> tasks;
+    for (size_t c = 0; c < cols.size(); c++) {
+        const size_t length = detail::visit_numeric(*cols[c], [](const auto *, size_t count) { return count; });
+        const auto range = rows.clamp(length);
+        const size_t n = range.size();
+        first_row[c] = range.begin;
+        parts[c].resize((n + SUMMARY_BLOCK - 1) / SUMMARY_BLOCK);
+        for (size_t begin = 0; begin < n; begin += SUMMARY_TASK) {
+            tasks.push_back({ c, begin / SUMMARY_BLOCK, begin, std::min(begin + SUMMARY_TASK, n) });
+        }
+    }
+
+    detail::run_tasks(tasks.size(), threads, [&](size_t t) {
+        const auto &job = tasks[t];
+        detail::visit_numeric(*cols[job.column], [&](const auto *data, size_t) {
+            const auto *first = data + first_row[job.column] + job.begin;
+            detail::summarize_blocks(first, job.end - job.begin, parts[job.column].data() + job.first_block);
+        });
+    });
+
+    std::vector<summary> out;
+    out.reserve(cols.size());
+    for (auto &p : parts) out.push_back(detail::merge_pairwise(p.data(), p.size()));
+    return out;
+}
+
+/**
+ * @brief Statistics of one `%le` or `%d` column
+ */
+template<typename real, typename Alloc>
+auto summarize(const data_vector<real, Alloc> &col, size_t threads = 1, row_range rows = {}) -> summary
+{
+    return summarize(std::vector<const data_vector<real, Alloc> *>{ &col }, threads, rows).front();
+}
+
+/**
+ * @brief Statistics of the `values` columns per group of `key`, a `%s` or `%d` column.
+ *
+ * `key_of` maps a string key to the key of its group, e.g. a prefix of the element name. On a
+ * dictionary encoded key column it is called once per distinct value. Only `rows` are grouped, they
+ * are split into `threads` ranges (`0` for one per hardware thread) that are reduced concurrently.
+ */
+template<typename real, typename Alloc, typename KeyOf>
+auto summarize_by(const data_vector<real, Alloc> &key,
+    KeyOf &&key_of,
+    const std::vector<const data_vector<real, Alloc> *> &values,
+    size_t threads = 1,
+    row_range rows = {}) -> grouped_summary
+{
+    for (auto *v : values) {
+        if (v->size() != key.size()) throw std::runtime_error("column " + v->name + " differs in length from the key");
+    }
+    rows = rows.clamp(key.size());
+    grouped_summary out;
+    const auto groups = detail::group_rows(key, key_of, rows, out.keys);
+    for (auto *v : values) out.columns.push_back(v->name);
+
+    const size_t n = rows.size();
+    const size_t n_groups = out.keys.size();
+    threads = threads == 0 ? thread_pool::default_size() : threads;
+    const size_t ranges = std::max<size_t>(1, std::min(threads, n / SUMMARY_TASK));
+    const size_t range_size = n / ranges + 1;
+
+    // one accumulator per range, group and column, each range sweeps every column once
+    std::vector<detail::group_accumulator> acc(ranges * n_groups * values.size());
+    detail::run_tasks(ranges, threads, [&](size_t r) {
+        const size_t begin = r * range_size;
+        const size_t end = std::min(begin + range_size, n);
+        detail::group_accumulator *mine = acc.data() + r * n_groups * values.size();
+        for (size_t c = 0; c < values.size(); c++) {
+            detail::visit_numeric(*values[c], [&](const auto *column, size_t) {
+                const auto *data = column + rows.begin;
+                for (size_t i = begin; i < end; i++) {
+                    mine[groups[i] * values.size() + c].add(static_cast<double>(data[i]));
+                }
+            });
+        }
+    });
+
+    out.values.resize(n_groups * values.size());
+    for (size_t r = 0; r < ranges; r++) {
+        for (size_t i = 0; i < out.values.size(); i++) {
+            out.values[i] = merge(out.values[i], acc[r * out.values.size() + i].to_summary());
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Statistics of the `values` columns per distinct value of `key`
+ */
+template<typename real, typename Alloc>
+auto summarize_by(const data_vector<real, Alloc> &key,
+    const std::vector<const data_vector<real, Alloc> *> &values,
+    size_t threads = 1,
+    row_range rows = {}) -> grouped_summary
+{
+    return summarize_by(key, [](std::string_view k) { return k; }, values, threads, rows);
+}
+
+}// namespace tfs
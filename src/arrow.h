@@ -0,0 +1,591 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tfs_dataframe.h"
+
+// ----------------------------------------------------------------------------------------
+// ---- Arrow C Data Interface ------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// The two structs of https://arrow.apache.org/docs/format/CDataInterface.html, guarded like the
+// specification asks so that they can coexist with the definitions of an Arrow library.
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema
+{
+    // Array type description
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema *);
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+struct ArrowArray
+{
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray *);
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+#endif// ARROW_C_DATA_INTERFACE
+
+namespace tfs {
+
+// A dataframe is exported as one struct array with a child per column, e.g. to
+// `pyarrow.RecordBatch._import_from_c` and from there to pandas:
+//
+//   %le   `g` (`f` for `dataframe<float>`)  the column vector itself
+//   %d    `i`                               the column vector itself
+//   %b    `b`                               the words of the `bit_column` (little endian hosts)
+//   %lec  struct `+s` of `re` and `im`      the split real and imaginary vectors
+//   %s    `u` (`U` past 2 GiB of text)      offsets and text built for the export, without the
+//                                           surrounding quotes of the TFS values
+//
+// The properties go to the metadata of the struct, values as their text (strings without quotes)
+// and the TFS type of each under `tfs.type.KEY`, so that the types survive a round trip. Metadata
+// from other producers, without types, are typed by what their text parses as.
+// The exported arrays keep the dataframe alive through a `shared_ptr` until the consumer has
+// released all of them, so no cell is copied except for strings.
+//
+// Import accepts the same layouts, `l` (int64) for `%d` and null entries, which become the missing
+// values of `data_vector::gather_or_missing`. Columns own `std::vector`s, so imported buffers are
+// copied, in one go per column where there are no nulls.
+
+/// metadata key prefix of the TFS type of the property after it
+constexpr std::string_view ARROW_TYPE_KEY = "tfs.type.";
+
+namespace detail {
+
+    struct arrow_schema_data
+    {
+        std::string format;
+        std::string name;
+        std::string metadata;
+        std::vector<ArrowSchema> children;
+        std::vector<ArrowSchema *> child_pointers;
+    };
+
+    inline void release_arrow_schema(ArrowSchema *schema)
+    {
+        auto *data = static_cast<arrow_schema_data *>(schema->private_data);
+        for (auto &child : data->children) {
+            if (child.release != nullptr) child.release(&child);
+        }
+        delete data;
+        schema->release = nullptr;
+    }
+
+    /**
+     * @brief Fills `out` as a schema owning its strings, `children` children are left for the caller
+     */
+    inline auto make_arrow_schema(ArrowSchema *out,
+        std::string format,
+        std::string name,
+        size_t children = 0,
+        std::string metadata = {}) -> arrow_schema_data &
+    {
+        auto *data = new arrow_schema_data{ std::move(format), std::move(name), std::move(metadata), {}, {} };
+        data->children.resize(children);
+        for (auto &c : data->children) data->child_pointers.push_back(&c);
+        out->format = data->format.c_str();
+        out->name = data->name.c_str();
+        out->metadata = data->metadata.empty() ? nullptr : data->metadata.data();
+        out->flags = 0;
+        out->n_children = static_cast<int64_t>(children);
+        out->children = children == 0 ? nullptr : data->child_pointers.data();
+        out->dictionary = nullptr;
+        out->release = release_arrow_schema;
+        out->private_data = data;
+        return *data;
+    }
+
+    struct arrow_array_data
+    {
+        /// keeps the exported buffers alive
+        std::shared_ptr<const void> owner;
+        std::vector<const void *> buffers;
+        /// buffers built for the export
+        std::vector<int32_t> offsets;
+        std::vector<int64_t> large_offsets;
+        std::vector<uint8_t> bytes;
+        std::vector<ArrowArray> children;
+        std::vector<ArrowArray *> child_pointers;
+    };
+
+    inline void release_arrow_array(ArrowArray *array)
+    {
+        auto *data = static_cast<arrow_array_data *>(array->private_data);
+        for (auto &child : data->children) {
+            if (child.release != nullptr) child.release(&child);
+        }
+        delete data;
+        array->release = nullptr;
+    }
+
+    /**
+     * @brief Fills `out` as an array of `length` values without nulls, the buffers `buffers` are
+     * set by the caller (the validity buffer stays null)
+     */
+    inline auto make_arrow_array(ArrowArray *out,
+        size_t length,
+        std::shared_ptr<const void> owner,
+        size_t buffers,
+        size_t children = 0) -> arrow_array_data &
+    {
+        auto *data = new arrow_array_data{ std::move(owner), {}, {}, {}, {}, {}, {} };
+        data->buffers.resize(buffers, nullptr);
+        data->children.resize(children);
+        for (auto &c : data->children) data->child_pointers.push_back(&c);
+        out->length = static_cast<int64_t>(length);
+        out->null_count = 0;
+        out->offset = 0;
+        out->n_buffers = static_cast<int64_t>(buffers);
+        out->n_children = static_cast<int64_t>(children);
+        out->buffers = data->buffers.data();
+        out->children = children == 0 ? nullptr : data->child_pointers.data();
+        out->dictionary = nullptr;
+        out->release = release_arrow_array;
+        out->private_data = data;
+        return *data;
+    }
+
+    inline auto little_endian() -> bool
+    {
+        const uint16_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    /**
+     * @brief A TFS string value without surrounding blanks and quotes
+     */
+    inline auto unquote(std::string_view s) -> std::string_view
+    {
+        while (!s.empty() && s.front() == ' ') s.remove_prefix(1);
+        while (!s.empty() && s.back() == ' ') s.remove_suffix(1);
+        if (s.size() >= 2 && s.front() == '"' && s.back() == '"') s = s.substr(1, s.size() - 2);
+        return s;
+    }
+
+    template<typename real> constexpr auto arrow_real_format() -> const char *
+    {
+        static_assert(std::is_same_v<real, double> || std::is_same_v<real, float>, "Arrow has no such float type");
+        return std::is_same_v<real, double> ? "g" : "f";
+    }
+
+    template<typename Offset, typename real, typename Alloc>
+    void export_arrow_strings(const data_vector<real, Alloc> &col,
+        std::vector<Offset> &offsets,
+        std::vector<uint8_t> &text)
+    {
+        const size_t n = col.size();
+        offsets.reserve(n + 1);
+        offsets.push_back(0);
+        for (size_t i = 0; i < n; i++) {
+            const auto value = unquote(col.string_at(i));
+            text.insert(text.end(), value.begin(), value.end());
+            offsets.push_back(static_cast<Offset>(text.size()));
+        }
+    }
+
+    template<typename real, typename Alloc>
+    void export_arrow_column(const data_vector<real, Alloc> &col,
+        const std::string &name,
+        const std::shared_ptr<const void> &owner,
+        ArrowSchema *schema,
+        ArrowArray *array)
+    {
+        const size_t n = col.size();
+        switch (col.type) {
+        case DataType::LE:
+            make_arrow_schema(schema, arrow_real_format<real>(), name);
+            make_arrow_array(array, n, owner, 2).buffers[1] = col.as_real_vector().data();
+            break;
+        case DataType::D:
+            static_assert(sizeof(int) == sizeof(int32_t));
+            make_arrow_schema(schema, "i", name);
+            make_arrow_array(array, n, owner, 2).buffers[1] = col.as_int_vector().data();
+            break;
+        case DataType::B: {
+            make_arrow_schema(schema, "b", name);
+            auto &data = make_arrow_array(array, n, owner, 2);
+            const auto &bits = col.as_bool_column();
+            if (little_endian()) {
+                data.buffers[1] = bits.data();
+            } else {
+                // bit i of the Arrow bitmap is bit i % 8 of byte i / 8
+                data.bytes.resize((n + 7) / 8);
+                for (size_t i = 0; i < n; i++) data.bytes[i / 8] |= static_cast<uint8_t>(bits[i] << (i % 8));
+                data.buffers[1] = data.bytes.data();
+            }
+            break;
+        }
+        case DataType::S: {
+            auto &data = make_arrow_array(array, n, owner, 3);
+            size_t bytes = 0;
+            for (size_t i = 0; i < n; i++) bytes += unquote(col.string_at(i)).size();
+            data.bytes.reserve(bytes);
+            if (bytes <= static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+                make_arrow_schema(schema, "u", name);
+                export_arrow_strings(col, data.offsets, data.bytes);
+                data.buffers[1] = data.offsets.data();
+            } else {
+                make_arrow_schema(schema, "U", name);
+                export_arrow_strings(col, data.large_offsets, data.bytes);
+                data.buffers[1] = data.large_offsets.data();
+            }
+            data.buffers[2] = data.bytes.data();
+            break;
+        }
+        case DataType::C: {
+            const auto &z = col.as_complex_vector();
+            auto &schemas = make_arrow_schema(schema, "+s", name, 2);
+            auto &arrays = make_arrow_array(array, n, owner, 1, 2);
+            make_arrow_schema(&schemas.children[0], arrow_real_format<real>(), "re");
+            make_arrow_schema(&schemas.children[1], arrow_real_format<real>(), "im");
+            make_arrow_array(&arrays.children[0], n, owner, 2).buffers[1] = z.re.data();
+            make_arrow_array(&arrays.children[1], n, owner, 2).buffers[1] = z.im.data();
+            break;
+        }
+        }
+    }
+
+    /**
+     * @brief Arrow metadata: the number of pairs, then each key and value preceded by its length,
+     * all lengths native `int32`. Every property is followed by its `ARROW_TYPE_KEY` pair.
+     */
+    template<typename real> auto encode_arrow_metadata(const std::map<std::string, data_value<real>> &properties)
+        -> std::string
+    {
+        if (properties.empty()) return {};
+        std::string out;
+        auto append_int = [&out](size_t v) {
+            const auto i = static_cast<int32_t>(v);
+            out.append(reinterpret_cast<const char *>(&i), sizeof(i));
+        };
+        auto append_text = [&](std::string_view s) {
+            append_int(s.size());
+            out.append(s);
+        };
+
+        append_int(2 * properties.size());
+        char buffer[FORMAT_BUFFER];
+        char complex_buffer[COMPLEX_FORMAT_BUFFER];
+        for (auto &kvp : properties) {
+            append_text(kvp.first);
+            const auto &value = kvp.second;
+            switch (value.type) {
+            case DataType::LE:
+                append_text(format_real(buffer, value.get_double()));
+                break;
+            case DataType::D:
+                append_text(format_int(buffer, value.get_int()));
+                break;
+            case DataType::C:
+                append_text(format_complex(complex_buffer, value.get_complex()));
+                break;
+            case DataType::S:
+                append_text(unquote(std::get<std::string>(value.payload)));
+                break;
+            default:
+                append_text(value.pretty_print());
+                break;
+            }
+            append_text(std::string(ARROW_TYPE_KEY) + kvp.first);
+            append_text(string_fromDT(value.type));
+        }
+        return out;
+    }
+
+    /**
+     * @brief Property value of a metadata value of TFS type `type`
+     */
+    template<typename real> auto arrow_property(const std::string &text, DataType type) -> data_value<real>
+    {
+        switch (type) {
+        case DataType::D:
+            return data_value<real>(parse_int(text));
+        case DataType::LE:
+            return data_value<real>(parse_real<double>(text));
+        case DataType::C:
+            return data_value<real>(parse_complex<real>(text));
+        case DataType::B:
+            return data_value<real>(parse_bool(text));
+        default:
+            return data_value<real>("\"" + text + "\"");
+        }
+    }
+
+    /**
+     * @brief Property value of a metadata value without type, typed by what the text parses as
+     * completely
+     */
+    template<typename real> auto arrow_property(const std::string &text) -> data_value<real>
+    {
+        if (text.empty()) return data_value<real>(std::string("\"\""));
+        char *end = nullptr;
+        const long i = std::strtol(text.c_str(), &end, 10);
+        if (*end == '\0' && i >= std::numeric_limits<int>::min() && i <= std::numeric_limits<int>::max())
+            return data_value<real>(static_cast<int>(i));
+        const double d = std::strtod(text.c_str(), &end);
+        if (*end == '\0') return data_value<real>(d);
+        if (text == "True" || text == "False") return data_value<real>(text == "True");
+        if (text.back() == 'j') {
+            const auto z = parse_complex<real>(text);
+            char buffer[COMPLEX_FORMAT_BUFFER];
+            if (format_complex(buffer, z) == text) return data_value<real>(z);
+        }
+        return data_value<real>("\"" + text + "\"");
+    }
+
+    template<typename real>
+    void decode_arrow_metadata(const char *metadata, std::map<std::string, data_value<real>> &out)
+    {
+        if (metadata == nullptr) return;
+        auto read_int = [&metadata]() {
+            int32_t v;
+            std::memcpy(&v, metadata, sizeof(v));
+            metadata += sizeof(v);
+            return static_cast<size_t>(v);
+        };
+        auto read_text = [&]() {
+            const size_t n = read_int();
+            std::string s(metadata, n);
+            metadata += n;
+            return s;
+        };
+
+        const size_t pairs = read_int();
+        std::vector<std::pair<std::string, std::string>> values;
+        std::map<std::string, DataType> types;
+        for (size_t p = 0; p < pairs; p++) {
+            auto key = read_text();
+            auto value = read_text();
+            if (key.compare(0, ARROW_TYPE_KEY.size(), ARROW_TYPE_KEY) == 0)
+                types.emplace(key.substr(ARROW_TYPE_KEY.size()), DT_from_string(value));
+            else
+                values.emplace_back(std::move(key), std::move(value));
+        }
+        for (auto &[key, value] : values) {
+            const auto type = types.find(key);
+            out.insert_or_assign(key,
+                type != types.end() ? arrow_property<real>(value, type->second) : arrow_property<real>(value));
+        }
+    }
+
+    /**
+     * @brief Whether value `i` of `array` (already including its offset) is not null
+     */
+    inline auto arrow_valid(const ArrowArray &array, int64_t i) -> bool
+    {
+        if (array.null_count == 0 || array.buffers[0] == nullptr) return true;
+        const auto *bits = static_cast<const uint8_t *>(array.buffers[0]);
+        return (bits[i / 8] >> (i % 8)) & 1;
+    }
+
+    inline auto arrow_has_nulls(const ArrowArray &array) -> bool
+    {
+        return array.null_count != 0 && array.buffers[0] != nullptr;
+    }
+
+    template<typename To, typename From, typename Vector>
+    void import_arrow_values(const ArrowArray &array, int64_t first, size_t n, To missing, Vector &out)
+    {
+        const auto *values = static_cast<const From *>(array.buffers[1]) + first;
+        if (!arrow_has_nulls(array)) {
+            out.assign(values, values + n);
+            return;
+        }
+        out.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = arrow_valid(array, first + static_cast<int64_t>(i)) ? static_cast<To>(values[i]) : missing;
+        }
+    }
+
+    template<typename Offset, typename real, typename Alloc>
+    void import_arrow_strings(const ArrowArray &array, int64_t first, size_t n, data_vector<real, Alloc> &col)
+    {
+        const auto *offsets = static_cast<const Offset *>(array.buffers[1]) + first;
+        const auto *text = static_cast<const char *>(array.buffers[2]);
+        std::string quoted;
+        for (size_t i = 0; i < n; i++) {
+            quoted.assign(1, '"');
+            if (arrow_valid(array, first + static_cast<int64_t>(i)))
+                quoted.append(text + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i]));
+            quoted.push_back('"');
+            col.as_string_vector_mut().emplace_back(quoted);
+        }
+    }
+
+    /**
+     * @brief Appends `n` values of the child `array` from row `row` of its parent on to `df`
+     */
+    template<typename real, typename Alloc>
+    void import_arrow_column(const ArrowSchema &schema,
+        const ArrowArray &array,
+        int64_t row,
+        size_t n,
+        dataframe<real, Alloc> &df)
+    {
+        const std::string name = schema.name != nullptr ? schema.name : "";
+        const std::string_view format = schema.format;
+        const int64_t first = row + array.offset;
+        if (array.length < first - array.offset + static_cast<int64_t>(n))
+            throw std::runtime_error("Arrow column " + name + " is shorter than the struct");
+        const real nan = std::numeric_limits<real>::quiet_NaN();
+
+        if (format == "g") {
+            auto &values = df.add_column(name, DataType::LE).as_real_vector_mut();
+            import_arrow_values<real, double>(array, first, n, nan, values);
+        } else if (format == "f") {
+            auto &values = df.add_column(name, DataType::LE).as_real_vector_mut();
+            import_arrow_values<real, float>(array, first, n, nan, values);
+        } else if (format == "i") {
+            import_arrow_values<int, int32_t>(array, first, n, 0, df.add_column(name, DataType::D).as_int_vector_mut());
+        } else if (format == "l") {
+            const auto *values = static_cast<const int64_t *>(array.buffers[1]) + first;
+            for (size_t i = 0; i < n; i++) {
+                const bool fits =
+                    values[i] >= std::numeric_limits<int>::min() && values[i] <= std::numeric_limits<int>::max();
+                if (!fits && arrow_valid(array, first + static_cast<int64_t>(i)))
+                    throw std::runtime_error("Arrow column " + name + " has values out of the range of %d");
+            }
+            import_arrow_values<int, int64_t>(array, first, n, 0, df.add_column(name, DataType::D).as_int_vector_mut());
+        } else if (format == "b") {
+            auto &bits = df.add_column(name, DataType::B).as_bool_column_mut();
+            const auto *values = static_cast<const uint8_t *>(array.buffers[1]);
+            bits.reserve(n);
+            for (int64_t i = first; i < first + static_cast<int64_t>(n); i++) {
+                bits.push_back(arrow_valid(array, i) && ((values[i / 8] >> (i % 8)) & 1));
+            }
+        } else if (format == "u" || format == "U") {
+            auto &col = df.add_column(name, DataType::S);
+            col.reserve(n);
+            if (format == "u")
+                import_arrow_strings<int32_t>(array, first, n, col);
+            else
+                import_arrow_strings<int64_t>(array, first, n, col);
+        } else if (format == "+s" && schema.n_children == 2 && array.n_children == 2) {
+            // complex column of two float children
+            dataframe<real, Alloc> parts;
+            for (int64_t c = 0; c < 2; c++) {
+                import_arrow_column(*schema.children[c], *array.children[c], first, n, parts);
+            }
+            const auto &re = parts.get_column(0).as_real_vector();
+            const auto &im = parts.get_column(1).as_real_vector();
+            auto &z = df.add_column(name, DataType::C).as_complex_vector_mut();
+            z.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                const bool valid = arrow_valid(array, first + static_cast<int64_t>(i));
+                z.push_back(valid ? std::complex<real>(re[i], im[i]) : std::complex<real>(nan, nan));
+            }
+        } else {
+            throw std::runtime_error("Arrow column " + name + " has the unsupported format " + std::string(format));
+        }
+    }
+
+}// namespace detail
+
+/**
+ * @brief Exports `df` as a struct array through the Arrow C Data Interface into `schema` and `array`.
+ *
+ * `%le`, `%d`, `%b` and `%lec` buffers are shared with the dataframe, which the exported arrays keep
+ * alive until the consumer releases them. The dataframe must not be modified meanwhile.
+ */
+template<typename real, typename Alloc>
+void export_arrow(std::shared_ptr<const dataframe<real, Alloc>> df, ArrowSchema *schema, ArrowArray *array)
+{
+    const auto names = df->column_names();
+    auto &schemas = detail::make_arrow_schema(
+        schema, "+s", "", names.size(), detail::encode_arrow_metadata(df->get_properties()));
+    auto &arrays = detail::make_arrow_array(array, df->size(), df, 1, names.size());
+    for (size_t c = 0; c < names.size(); c++) {
+        detail::export_arrow_column(df->get_column(names[c]), names[c], df, &schemas.children[c], &arrays.children[c]);
+    }
+}
+
+/**
+ * @brief Exports `df`, which moves into the exported arrays
+ */
+template<typename real, typename Alloc>
+void export_arrow(dataframe<real, Alloc> &&df, ArrowSchema *schema, ArrowArray *array)
+{
+    export_arrow(std::make_shared<const dataframe<real, Alloc>>(std::move(df)), schema, array);
+}
+
+/**
+ * @brief Reads a struct array of the Arrow C Data Interface into a new dataframe.
+ *
+ * Takes ownership of `schema` and `array` and releases them before returning. Metadata become
+ * properties of the type in their `tfs.type.KEY` entry, metadata without one (from other
+ * producers) are typed by what their text parses as. String values get the quotes of TFS strings.
+ * Throws for types without a TFS counterpart.
+ */
+template<typename real = double, typename Alloc = std::allocator<char>>
+auto import_arrow(ArrowSchema *schema, ArrowArray *array, const Alloc &alloc = Alloc()) -> dataframe<real, Alloc>
+{
+    struct release_guard
+    {
+        ArrowSchema *schema;
+        ArrowArray *array;
+        ~release_guard()
+        {
+            if (array->release != nullptr) array->release(array);
+            if (schema->release != nullptr) schema->release(schema);
+        }
+    } guard{ schema, array };
+
+    if (std::string_view(schema->format) != "+s") throw std::runtime_error("Arrow data to import is not a struct");
+    if (schema->n_children != array->n_children) throw std::runtime_error("Arrow schema and array differ in columns");
+
+    dataframe<real, Alloc> df(alloc);
+    std::map<std::string, data_value<real>> properties;
+    detail::decode_arrow_metadata(schema->metadata, properties);
+    for (auto &kvp : properties) df.insert_property(kvp.first, kvp.second);
+
+    const auto n = static_cast<size_t>(array->length);
+    for (int64_t c = 0; c < array->n_children; c++) {
+        detail::import_arrow_column(*schema->children[c], *array->children[c], array->offset, n, df);
+    }
+    return df;
+}
+
+}// namespace tfs
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "tfs_dataframe.h"
+#include "thread_pool.h"
+
+namespace tfs {
+
+/**
+ * @brief Streams the rows of a TFS file in fixed-size batches.
+ *
+ * The header is parsed once, after that every call to `next()` replaces the rows of `batch()` with
+ * the next `batch_size` rows of the file. The columns of the batch keep their storage between
+ * calls, so memory use is bounded by the batch size and not by the file size.
+ *
+ * With `prefetch` the following batch is parsed on a background thread while the current one is
+ * being processed. This needs a second batch buffer.
+ *
+ * ```cpp
+ * tfs::batch_reader<double> reader{"tracking.tfs", 10000};
+ * while (reader.next()) {
+ *     auto &x = reader.batch().get_column("X").as_real_vector();
+ *     ...
+ * }
+ * ```
+ */
+template<typename real = double> class batch_reader
+{
+  public:
+    /**
+     * @brief Opens `path` and reads its header.
+     *
+     * `options.columns` and `options.index` work like for the dataframe constructor, the index is
+     * built per batch. `memory_map` and `threads` do not apply to streaming.
+     */
+    batch_reader(const std::string &path, size_t batch_size, const read_options &options = {}, bool prefetch = false)
+        : file(path), batch_size(batch_size), index(options.index)
+    {
+        if (!file.is_open()) throw std::runtime_error("could not open file " + path);
+        if (batch_size == 0) throw std::runtime_error("batch size must not be zero");
+
+        current.read_header_stream(file, options);
+        if (prefetch) {
+            spare = dataframe<real>(current);
+            worker = std::make_unique<thread_pool>(1);
+        }
+    }
+
+    batch_reader(const batch_reader &) = delete;
+    batch_reader &operator=(const batch_reader &) = delete;
+
+    ~batch_reader()
+    {
+        if (pending.valid()) pending.wait();
+    }
+
+    /**
+     * @brief Reads the next batch into `batch()`
+     *
+     * @return false if the file is exhausted, `batch()` is empty then
+     */
+    bool next()
+    {
+        bool got;
+        if (pending.valid()) {
+            got = pending.get();
+            std::swap(current, spare);
+        } else {
+            got = fill(current);
+        }
+        if (!got) return false;
+
+        rows += current.size();
+        if (worker) pending = worker->submit([this] { return fill(spare); });
+        return true;
+    }
+
+    /**
+     * @brief The current batch. Properties and column layout are those of the file.
+     */
+    [[nodiscard]] auto batch() -> dataframe<real> & { return current; }
+
+    /**
+     * @brief Number of rows handed out so far, including the current batch
+     */
+    [[nodiscard]] auto rows_read() const -> size_t { return rows; }
+
+  private:
+    /**
+     * @brief Parses up to `batch_size` lines into `df`. Only ever runs on one thread at a time.
+     */
+    bool fill(dataframe<real> &df)
+    {
+        for (auto &c : df.columns) c.clear();
+        df.idx.clear();
+
+        size_t lines = 0;
+        while (lines < batch_size && std::getline(file, line)) {
+            df.read_line(line, df.columns);
+            lines++;
+        }
+
+        df.build_index(index);
+        return lines > 0;
+    }
+
+    std::ifstream file;
+    size_t batch_size;
+    std::string index;
+    std::string line;
+    size_t rows = 0;
+
+    dataframe<real> current;
+    dataframe<real> spare;
+    std::unique_ptr<thread_pool> worker;
+    std::future<bool> pending;
+};
+
+}// namespace tfs
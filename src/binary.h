@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace tfs {
+
+/*
+ * Binary columnar TFS layout, all integers in native byte order:
+ *
+ *   "TFSBIN02"  u32 byte order marker  u32 sizeof(real)
+ *   u64 #properties, per property:  str key  u32 type  value (f64 | i64 | str | u8 | 2 x f64)
+ *   u64 #columns, per column:       str name  u32 type  u64 #elements  u64 #bytes  padding to 8  data
+ *
+ * `str` is a u64 length followed by the characters. Column data is the raw array for `%le` and `%d`
+ * columns, the real parts followed by the imaginary parts for `%lec`, the u64 words of the packed
+ * `bit_column` for `%b` and a string table (u64 offsets[#elements + 1] followed by the characters)
+ * for `%s`. Column data is 8 byte aligned relative to the start of the file, so a
+ * mapping of the file can be read without unaligned access.
+ */
+
+constexpr char BINARY_MAGIC[8] = { 'T', 'F', 'S', 'B', 'I', 'N', '0', '2' };
+constexpr uint32_t BINARY_BYTE_ORDER = 0x01020304;
+constexpr size_t BINARY_ALIGNMENT = 8;
+
+/**
+ * @brief Writes the primitives of the binary layout to a stream, keeping track of the position
+ */
+class binary_writer
+{
+  public:
+    explicit binary_writer(std::ostream &os) : os(os) {}
+
+    void bytes(const void *data, size_t n)
+    {
+        os.write(static_cast<const char *>(data), static_cast<std::streamsize>(n));
+        pos += n;
+    }
+
+    template<typename T> void value(T v)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes(&v, sizeof(T));
+    }
+
+    void string(std::string_view s)
+    {
+        value<uint64_t>(s.size());
+        bytes(s.data(), s.size());
+    }
+
+    void align()
+    {
+        static const char zeros[BINARY_ALIGNMENT] = {};
+        const size_t rem = pos % BINARY_ALIGNMENT;
+        if (rem != 0) bytes(zeros, BINARY_ALIGNMENT - rem);
+    }
+
+  private:
+    std::ostream &os;
+    size_t pos = 0;
+};
+
+/**
+ * @brief Reads the primitives of the binary layout from a buffer, throws on truncated input
+ */
+class binary_reader
+{
+  public:
+    explicit binary_reader(std::string_view buffer) : buffer(buffer) {}
+
+    auto bytes(size_t n) -> const char *
+    {
+        if (n > buffer.size() - pos) throw std::runtime_error("truncated binary tfs file");
+        const char *p = buffer.data() + pos;
+        pos += n;
+        return p;
+    }
+
+    template<typename T> auto value() -> T
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T v;
+        std::memcpy(&v, bytes(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+    auto string() -> std::string_view
+    {
+        const auto n = static_cast<size_t>(value<uint64_t>());
+        return { bytes(n), n };
+    }
+
+    void align()
+    {
+        const size_t rem = pos % BINARY_ALIGNMENT;
+        if (rem != 0) bytes(BINARY_ALIGNMENT - rem);
+    }
+
+  private:
+    std::string_view buffer;
+    size_t pos = 0;
+};
+
+}// namespace tfs
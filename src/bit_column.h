@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace tfs {
+
+inline auto popcount64(uint64_t w) -> size_t
+{
+#if defined(_MSC_VER)
+    return static_cast<size_t>(__popcnt64(w));
+#else
+    return static_cast<size_t>(__builtin_popcountll(w));
+#endif
+}
+
+/**
+ * @brief Index of the lowest set bit, `w` must not be 0
+ */
+inline auto lowest_bit64(uint64_t w) -> size_t
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, w);
+    return static_cast<size_t>(i);
+#else
+    return static_cast<size_t>(__builtin_ctzll(w));
+#endif
+}
+
+/**
+ * @brief Boolean column packed into 64 bit words, bit `i % 64` of word `i / 64` is row `i`.
+ *
+ * Bits past `size()` in the last word are always 0, so counting and the word-wise operators never
+ * need to mask the tail. `&=`, `|=` and `flip` are plain loops over the words that the compiler
+ * vectorizes. Set rows can be visited directly with `for_each_set`, which is how masks select
+ * rows without being expanded to a byte or a row number per row.
+ */
+class bit_column
+{
+  public:
+    static constexpr size_t WORD_BITS = 64;
+
+    bit_column() = default;
+
+    explicit bit_column(size_t n, bool value = false) { resize(n, value); }
+
+    /**
+     * @brief Column of `count` rows where row `i` is `pred(i)`.
+     *
+     * Bits are assembled one word at a time without branches, so a cheap `pred` vectorizes.
+     */
+    template<typename Pred> static auto from_predicate(size_t count, Pred &&pred) -> bit_column
+    {
+        bit_column mask(count);
+        uint64_t *w = mask.words.data();
+        for (size_t begin = 0; begin < count; begin += WORD_BITS) {
+            const size_t end = std::min(begin + WORD_BITS, count);
+            uint64_t bits = 0;
+            for (size_t i = begin; i < end; i++) {
+                bits |= static_cast<uint64_t>(static_cast<bool>(pred(i))) << (i - begin);
+            }
+            w[begin / WORD_BITS] = bits;
+        }
+        return mask;
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Insertion -------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    void push_back(bool b)
+    {
+        if (n % WORD_BITS == 0) words.push_back(0);
+        words.back() |= static_cast<uint64_t>(b) << (n % WORD_BITS);
+        n++;
+    }
+
+    void set(size_t i, bool b)
+    {
+        const uint64_t bit = uint64_t(1) << (i % WORD_BITS);
+        if (b)
+            words[i / WORD_BITS] |= bit;
+        else
+            words[i / WORD_BITS] &= ~bit;
+    }
+
+    /**
+     * @brief Appends all values of `other`
+     */
+    void append(const bit_column &other)
+    {
+        const size_t shift = n % WORD_BITS;
+        if (shift == 0) {
+            words.insert(words.end(), other.words.begin(), other.words.end());
+            n += other.n;
+            return;
+        }
+        words.reserve(word_count(n + other.n));
+        for (auto w : other.words) {
+            words.back() |= w << shift;
+            words.push_back(w >> (WORD_BITS - shift));
+        }
+        n += other.n;
+        words.resize(word_count(n));
+    }
+
+    void resize(size_t count, bool value = false)
+    {
+        if (count > n && value) {
+            // fill the tail of the current last word before adding full words
+            for (; n < count && n % WORD_BITS != 0; n++) words.back() |= uint64_t(1) << (n % WORD_BITS);
+        }
+        words.resize(word_count(count), value ? ~uint64_t(0) : 0);
+        n = count;
+        clear_tail();
+    }
+
+    void reserve(size_t count) { words.reserve(word_count(count)); }
+
+    void clear()
+    {
+        words.clear();
+        n = 0;
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Extraction ------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    [[nodiscard]] auto operator[](size_t i) const -> bool { return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1; }
+
+    [[nodiscard]] auto size() const -> size_t { return n; }
+
+    /**
+     * @brief Number of set rows
+     */
+    [[nodiscard]] auto count() const -> size_t
+    {
+        size_t c = 0;
+        for (auto w : words) c += popcount64(w);
+        return c;
+    }
+
+    [[nodiscard]] auto any() const -> bool
+    {
+        return std::any_of(words.begin(), words.end(), [](uint64_t w) { return w != 0; });
+    }
+
+    /**
+     * @brief Calls `f(row)` for every set row in ascending order
+     */
+    template<typename F> void for_each_set(F &&f) const
+    {
+        for (size_t wi = 0; wi < words.size(); wi++) {
+            for (uint64_t w = words[wi]; w != 0; w &= w - 1) f(wi * WORD_BITS + lowest_bit64(w));
+        }
+    }
+
+    /**
+     * @brief Row numbers of all set rows, ascending
+     */
+    [[nodiscard]] auto to_selection() const -> std::vector<size_t>
+    {
+        std::vector<size_t> rows;
+        rows.reserve(count());
+        for_each_set([&rows](size_t row) { rows.push_back(row); });
+        return rows;
+    }
+
+    [[nodiscard]] auto data() const -> const uint64_t * { return words.data(); }
+    [[nodiscard]] auto data() -> uint64_t * { return words.data(); }
+    [[nodiscard]] auto word_size() const -> size_t { return words.size(); }
+
+    [[nodiscard]] auto memory_usage() const -> size_t { return words.capacity() * sizeof(uint64_t); }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Mask operations -------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    auto operator&=(const bit_column &other) -> bit_column &
+    {
+        check_size(other);
+        uint64_t *a = words.data();
+        const uint64_t *b = other.words.data();
+        for (size_t i = 0; i < words.size(); i++) a[i] &= b[i];
+        return *this;
+    }
+
+    auto operator|=(const bit_column &other) -> bit_column &
+    {
+        check_size(other);
+        uint64_t *a = words.data();
+        const uint64_t *b = other.words.data();
+        for (size_t i = 0; i < words.size(); i++) a[i] |= b[i];
+        return *this;
+    }
+
+    /**
+     * @brief Inverts every row in place
+     */
+    auto flip() -> bit_column &
+    {
+        uint64_t *a = words.data();
+        for (size_t i = 0; i < words.size(); i++) a[i] = ~a[i];
+        clear_tail();
+        return *this;
+    }
+
+    friend auto operator&(bit_column a, const bit_column &b) -> bit_column { return a &= b; }
+    friend auto operator|(bit_column a, const bit_column &b) -> bit_column { return a |= b; }
+    friend auto operator~(bit_column a) -> bit_column { return a.flip(); }
+
+    friend auto operator==(const bit_column &a, const bit_column &b) -> bool
+    {
+        return a.n == b.n && a.words == b.words;
+    }
+
+  private:
+    static auto word_count(size_t bits) -> size_t { return (bits + WORD_BITS - 1) / WORD_BITS; }
+
+    void clear_tail()
+    {
+        if (n % WORD_BITS != 0) words.back() &= (uint64_t(1) << (n % WORD_BITS)) - 1;
+    }
+
+    void check_size(const bit_column &other) const
+    {
+        if (n != other.n) throw std::runtime_error("boolean columns differ in length");
+    }
+
+    std::vector<uint64_t> words;
+    size_t n = 0;
+};
+
+}// namespace tfs
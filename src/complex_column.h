@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace tfs {
+
+/**
+ * @brief Complex column stored as split (structure of arrays) real and imaginary parts.
+ *
+ * Keeping both parts in separate contiguous arrays lets the column kernels below run as plain
+ * element-wise loops that the compiler vectorizes.
+ */
+template<typename real> struct split_complex
+{
+    std::vector<real> re;
+    std::vector<real> im;
+
+    [[nodiscard]] auto size() const -> size_t { return re.size(); }
+
+    [[nodiscard]] auto operator[](size_t i) const -> std::complex<real> { return { re[i], im[i] }; }
+
+    void push_back(std::complex<real> c)
+    {
+        re.push_back(c.real());
+        im.push_back(c.imag());
+    }
+
+    void reserve(size_t n)
+    {
+        re.reserve(n);
+        im.reserve(n);
+    }
+
+    void clear()
+    {
+        re.clear();
+        im.clear();
+    }
+
+    void resize(size_t n)
+    {
+        re.resize(n);
+        im.resize(n);
+    }
+
+    void append(const split_complex &other)
+    {
+        re.insert(re.end(), other.re.begin(), other.re.end());
+        im.insert(im.end(), other.im.begin(), other.im.end());
+    }
+
+    [[nodiscard]] auto to_vector() const -> std::vector<std::complex<real>>
+    {
+        std::vector<std::complex<real>> v(size());
+        for (size_t i = 0; i < size(); i++) v[i] = (*this)[i];
+        return v;
+    }
+};
+
+// ----------------------------------------------------------------------------------------
+// ---- Column kernels --------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+
+/**
+ * @brief |z| of every element, without overflow or underflow of the squares: both parts are scaled
+ * by the larger one first, like `std::hypot` does
+ */
+template<typename real> auto amplitude(const split_complex<real> &z) -> std::vector<real>
+{
+    const size_t n = z.size();
+    std::vector<real> out(n);
+    const real *re = z.re.data();
+    const real *im = z.im.data();
+    real *o = out.data();
+    constexpr real largest = std::numeric_limits<real>::max();
+    constexpr real smallest = std::numeric_limits<real>::denorm_min();
+    for (size_t i = 0; i < n; i++) {
+        const real a = std::abs(re[i]);
+        const real b = std::abs(im[i]);
+        const real big = a > b ? a : b;
+        const real small = a > b ? b : a;
+        // clamped so that 0 / 0 and inf / inf cannot happen, NaN passes through; selects, not
+        // branches, so the loop still vectorizes
+        const real t = (small > largest ? largest : small) / (big < smallest ? smallest : big);
+        o[i] = big * std::sqrt(1 + t * t);
+    }
+    return out;
+}
+
+/**
+ * @brief arg(z) of every element, in (-pi, pi]
+ */
+template<typename real> auto phase(const split_complex<real> &z) -> std::vector<real>
+{
+    const size_t n = z.size();
+    std::vector<real> out(n);
+    const real *re = z.re.data();
+    const real *im = z.im.data();
+    real *o = out.data();
+    for (size_t i = 0; i < n; i++) o[i] = std::atan2(im[i], re[i]);
+    return out;
+}
+
+/**
+ * @brief a * conj(b), element-wise
+ */
+template<typename real>
+auto conj_multiply(const split_complex<real> &a, const split_complex<real> &b) -> split_complex<real>
+{
+    if (a.size() != b.size()) throw std::runtime_error("complex columns differ in length");
+    const size_t n = a.size();
+    split_complex<real> out;
+    out.resize(n);
+    const real *ar = a.re.data();
+    const real *ai = a.im.data();
+    const real *br = b.re.data();
+    const real *bi = b.im.data();
+    real *orr = out.re.data();
+    real *oi = out.im.data();
+    for (size_t i = 0; i < n; i++) {
+        orr[i] = ar[i] * br[i] + ai[i] * bi[i];
+        oi[i] = ai[i] * br[i] - ar[i] * bi[i];
+    }
+    return out;
+}
+
+}// namespace tfs
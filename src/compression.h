@@ -0,0 +1,572 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(TFS_CPP_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(TFS_CPP_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace tfs {
+
+enum class compression {
+    automatic,// gzip for `.gz` file names, zstd for `.zst`, none otherwise
+    none,
+    gzip,
+    zstd,
+};
+
+/// size of the blocks handed between the (de)compression thread and the parser or formatter
+constexpr size_t COMPRESSION_BLOCK = 1 << 20;
+
+/// number of blocks the (de)compression thread may run ahead
+constexpr size_t COMPRESSION_QUEUE_DEPTH = 4;
+
+/**
+ * @brief Compression of an existing file, recognized by its magic bytes
+ */
+inline auto detect_compression(const std::string &path) -> compression
+{
+    std::ifstream file(path, std::ios::binary);
+    unsigned char magic[4] = {};
+    file.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return compression::gzip;
+    if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return compression::zstd;
+    return compression::none;
+}
+
+/**
+ * @brief Compression to use for writing `path` with the requested mode
+ */
+inline auto resolve_compression(const std::string &path, compression requested) -> compression
+{
+    if (requested != compression::automatic) return requested;
+    auto ends_with = [&path](std::string_view suffix) {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (ends_with(".gz")) return compression::gzip;
+    if (ends_with(".zst")) return compression::zstd;
+    return compression::none;
+}
+
+// ----------------------------------------------------------------------------------------
+// ---- Sources ---------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+
+/**
+ * @brief Sequential stream of (decompressed) file bytes
+ */
+class byte_source
+{
+  public:
+    virtual ~byte_source() = default;
+
+    /**
+     * @brief Reads up to `n` bytes into `out`
+     *
+     * @return number of bytes read, 0 only at the end of the data
+     */
+    virtual auto read(char *out, size_t n) -> size_t = 0;
+};
+
+class file_source : public byte_source
+{
+  public:
+    explicit file_source(const std::string &path) : file(path, std::ios::binary)
+    {
+        if (!file.is_open()) throw std::runtime_error("could not open file " + path);
+    }
+
+    auto read(char *out, size_t n) -> size_t override
+    {
+        file.read(out, static_cast<std::streamsize>(n));
+        return static_cast<size_t>(file.gcount());
+    }
+
+  private:
+    std::ifstream file;
+};
+
+#if defined(TFS_CPP_ZLIB)
+class gzip_source : public byte_source
+{
+  public:
+    explicit gzip_source(const std::string &path) : file(gzopen(path.c_str(), "rb"))
+    {
+        if (file == nullptr) throw std::runtime_error("could not open file " + path);
+        gzbuffer(file, 1 << 17);
+    }
+
+    gzip_source(const gzip_source &) = delete;
+    gzip_source &operator=(const gzip_source &) = delete;
+
+    ~gzip_source() override { gzclose_r(file); }
+
+    auto read(char *out, size_t n) -> size_t override
+    {
+        const int got = gzread(file, out, static_cast<unsigned>(std::min<size_t>(n, 1u << 30)));
+        if (got < 0) throw std::runtime_error("corrupt gzip data");
+        if (got == 0) {
+            // a truncated file ends with Z_BUF_ERROR instead of failing the read
+            int error = Z_OK;
+            const char *message = gzerror(file, &error);
+            if (error != Z_OK) throw std::runtime_error(std::string("corrupt gzip data: ") + message);
+        }
+        return static_cast<size_t>(got);
+    }
+
+  private:
+    gzFile file;
+};
+#endif
+
+#if defined(TFS_CPP_ZSTD)
+class zstd_source : public byte_source
+{
+  public:
+    explicit zstd_source(const std::string &path)
+        : file(path, std::ios::binary), stream(ZSTD_createDStream()), in(ZSTD_DStreamInSize())
+    {
+        if (!file.is_open()) throw std::runtime_error("could not open file " + path);
+        ZSTD_initDStream(stream);
+    }
+
+    zstd_source(const zstd_source &) = delete;
+    zstd_source &operator=(const zstd_source &) = delete;
+
+    ~zstd_source() override { ZSTD_freeDStream(stream); }
+
+    auto read(char *out, size_t n) -> size_t override
+    {
+        ZSTD_outBuffer output = { out, n, 0 };
+        for (;;) {
+            if (input.pos == input.size && !at_end) {
+                file.read(in.data(), static_cast<std::streamsize>(in.size()));
+                input = { in.data(), static_cast<size_t>(file.gcount()), 0 };
+                at_end = input.size == 0;
+            }
+            const size_t consumed = input.pos;
+            const size_t result = ZSTD_decompressStream(stream, &output, &input);
+            if (ZSTD_isError(result)) throw std::runtime_error("corrupt zstd data");
+            // without progress the result is only the input hint for the next frame
+            if (output.pos > 0 || input.pos != consumed) in_frame = result != 0;
+            if (output.pos > 0) return output.pos;
+            if (at_end && input.pos == input.size) {
+                if (in_frame) throw std::runtime_error("truncated zstd data");
+                return 0;
+            }
+        }
+    }
+
+  private:
+    std::ifstream file;
+    ZSTD_DStream *stream;
+    std::vector<char> in;
+    ZSTD_inBuffer input = { nullptr, 0, 0 };
+    bool at_end = false;
+    /// the last frame has not been decompressed completely
+    bool in_frame = false;
+};
+#endif
+
+/**
+ * @brief Reads `source` on a background thread, `COMPRESSION_QUEUE_DEPTH` blocks ahead of the
+ * consumer, so decompression overlaps with parsing. Errors of the background thread are rethrown
+ * by `read`.
+ */
+class threaded_source : public byte_source
+{
+  public:
+    explicit threaded_source(std::unique_ptr<byte_source> source) : source(std::move(source))
+    {
+        worker = std::thread([this] { produce(); });
+    }
+
+    threaded_source(const threaded_source &) = delete;
+    threaded_source &operator=(const threaded_source &) = delete;
+
+    ~threaded_source() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    auto read(char *out, size_t n) -> size_t override
+    {
+        if (offset == current.size()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return !blocks.empty() || done; });
+            if (blocks.empty()) {
+                if (error) std::rethrow_exception(error);
+                return 0;
+            }
+            current = std::move(blocks.front());
+            blocks.pop_front();
+            offset = 0;
+            lock.unlock();
+            changed.notify_all();
+        }
+        const size_t count = std::min(n, current.size() - offset);
+        std::memcpy(out, current.data() + offset, count);
+        offset += count;
+        return count;
+    }
+
+  private:
+    void produce()
+    {
+        try {
+            for (;;) {
+                std::string block(COMPRESSION_BLOCK, '\0');
+                size_t filled = 0;
+                while (filled < block.size()) {
+                    const size_t got = source->read(block.data() + filled, block.size() - filled);
+                    if (got == 0) break;
+                    filled += got;
+                }
+                if (filled == 0) break;
+                block.resize(filled);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return blocks.size() < COMPRESSION_QUEUE_DEPTH || stopping; });
+                if (stopping) return;
+                blocks.push_back(std::move(block));
+                lock.unlock();
+                changed.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        changed.notify_all();
+    }
+
+    std::unique_ptr<byte_source> source;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> blocks;
+    std::string current;
+    size_t offset = 0;
+    bool done = false;
+    bool stopping = false;
+    std::exception_ptr error;
+};
+
+/**
+ * @brief Source for the decompressed contents of `path`
+ */
+inline auto open_source(const std::string &path, compression c) -> std::unique_ptr<byte_source>
+{
+    switch (c) {
+    case compression::gzip:
+#if defined(TFS_CPP_ZLIB)
+        return std::make_unique<gzip_source>(path);
+#else
+        throw std::runtime_error("tfs_cpp was built without zlib, cannot read " + path);
+#endif
+    case compression::zstd:
+#if defined(TFS_CPP_ZSTD)
+        return std::make_unique<zstd_source>(path);
+#else
+        throw std::runtime_error("tfs_cpp was built without zstd, cannot read " + path);
+#endif
+    default:
+        return std::make_unique<file_source>(path);
+    }
+}
+
+/**
+ * @brief Calls `f(line)` for every line of `in`, without the newline. The views are only valid
+ * during the call.
+ */
+template<typename F> void for_each_line(byte_source &in, F &&f)
+{
+    std::string buffer;
+    for (;;) {
+        const size_t kept = buffer.size();
+        buffer.resize(kept + COMPRESSION_BLOCK);
+        buffer.resize(kept + in.read(buffer.data() + kept, COMPRESSION_BLOCK));
+        if (buffer.size() == kept) break;
+
+        size_t pos = 0;
+        for (size_t end; (end = buffer.find('\n', pos)) != std::string::npos; pos = end + 1) {
+            f(std::string_view(buffer).substr(pos, end - pos));
+        }
+        buffer.erase(0, pos);
+    }
+    if (!buffer.empty()) f(std::string_view(buffer));
+}
+
+// ----------------------------------------------------------------------------------------
+// ---- Sinks -----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+
+/**
+ * @brief Sequential output that (optionally) compresses what is written
+ */
+class byte_sink
+{
+  public:
+    virtual ~byte_sink() = default;
+
+    virtual void write(const char *data, size_t n) = 0;
+
+    /**
+     * @brief Flushes everything, throws if any of the data could not be written
+     */
+    virtual void finish() = 0;
+};
+
+class file_sink : public byte_sink
+{
+  public:
+    explicit file_sink(const std::string &path) : file(path, std::ios::binary), path(path)
+    {
+        if (!file.is_open()) throw std::runtime_error("could not open file " + path);
+    }
+
+    void write(const char *data, size_t n) override { file.write(data, static_cast<std::streamsize>(n)); }
+
+    void finish() override
+    {
+        file.flush();
+        if (!file) throw std::runtime_error("could not write file " + path);
+    }
+
+  private:
+    std::ofstream file;
+    std::string path;
+};
+
+#if defined(TFS_CPP_ZLIB)
+class gzip_sink : public byte_sink
+{
+  public:
+    explicit gzip_sink(const std::string &path) : file(gzopen(path.c_str(), "wb")), path(path)
+    {
+        if (file == nullptr) throw std::runtime_error("could not open file " + path);
+        gzbuffer(file, 1 << 17);
+    }
+
+    gzip_sink(const gzip_sink &) = delete;
+    gzip_sink &operator=(const gzip_sink &) = delete;
+
+    ~gzip_sink() override
+    {
+        if (file != nullptr) gzclose_w(file);
+    }
+
+    void write(const char *data, size_t n) override
+    {
+        while (n > 0) {
+            const auto chunk = static_cast<unsigned>(std::min<size_t>(n, 1u << 30));
+            if (gzwrite(file, data, chunk) == 0) throw std::runtime_error("could not write file " + path);
+            data += chunk;
+            n -= chunk;
+        }
+    }
+
+    void finish() override
+    {
+        const int result = gzclose_w(file);
+        file = nullptr;
+        if (result != Z_OK) throw std::runtime_error("could not write file " + path);
+    }
+
+  private:
+    gzFile file;
+    std::string path;
+};
+#endif
+
+#if defined(TFS_CPP_ZSTD)
+class zstd_sink : public byte_sink
+{
+  public:
+    explicit zstd_sink(const std::string &path)
+        : file(path, std::ios::binary), path(path), stream(ZSTD_createCStream()), out(ZSTD_CStreamOutSize())
+    {
+        if (!file.is_open()) throw std::runtime_error("could not open file " + path);
+        ZSTD_initCStream(stream, 3);
+    }
+
+    zstd_sink(const zstd_sink &) = delete;
+    zstd_sink &operator=(const zstd_sink &) = delete;
+
+    ~zstd_sink() override { ZSTD_freeCStream(stream); }
+
+    void write(const char *data, size_t n) override
+    {
+        ZSTD_inBuffer input = { data, n, 0 };
+        while (input.pos < input.size) {
+            ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+            if (ZSTD_isError(ZSTD_compressStream(stream, &output, &input)))
+                throw std::runtime_error("could not compress " + path);
+            file.write(out.data(), static_cast<std::streamsize>(output.pos));
+        }
+    }
+
+    void finish() override
+    {
+        for (;;) {
+            ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+            const size_t remaining = ZSTD_endStream(stream, &output);
+            if (ZSTD_isError(remaining)) throw std::runtime_error("could not compress " + path);
+            file.write(out.data(), static_cast<std::streamsize>(output.pos));
+            if (remaining == 0) break;
+        }
+        file.flush();
+        if (!file) throw std::runtime_error("could not write file " + path);
+    }
+
+  private:
+    std::ofstream file;
+    std::string path;
+    ZSTD_CStream *stream;
+    std::vector<char> out;
+};
+#endif
+
+/**
+ * @brief Hands the written data to `sink` on a background thread, so compression overlaps with
+ * formatting. Errors of the background thread are rethrown by `write` or `finish`.
+ */
+class threaded_sink : public byte_sink
+{
+  public:
+    explicit threaded_sink(std::unique_ptr<byte_sink> sink) : sink(std::move(sink))
+    {
+        worker = std::thread([this] { consume(); });
+    }
+
+    threaded_sink(const threaded_sink &) = delete;
+    threaded_sink &operator=(const threaded_sink &) = delete;
+
+    ~threaded_sink() override
+    {
+        close();
+        if (worker.joinable()) worker.join();
+    }
+
+    void write(const char *data, size_t n) override
+    {
+        pending.append(data, n);
+        if (pending.size() >= COMPRESSION_BLOCK) push();
+    }
+
+    void finish() override
+    {
+        push();
+        close();
+        worker.join();
+        worker = std::thread();
+        if (error) std::rethrow_exception(error);
+        sink->finish();
+    }
+
+  private:
+    void push()
+    {
+        if (pending.empty()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return blocks.size() < COMPRESSION_QUEUE_DEPTH || error; });
+        if (error) std::rethrow_exception(error);
+        blocks.push_back(std::move(pending));
+        pending = std::string();
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+    void consume()
+    {
+        for (;;) {
+            std::string block;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return !blocks.empty() || closed; });
+                if (blocks.empty()) return;
+                block = std::move(blocks.front());
+                blocks.pop_front();
+            }
+            changed.notify_all();
+            try {
+                sink->write(block.data(), block.size());
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                error = std::current_exception();
+                blocks.clear();
+                changed.notify_all();
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<byte_sink> sink;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> blocks;
+    std::string pending;
+    bool closed = false;
+    std::exception_ptr error;
+};
+
+/**
+ * @brief Sink writing `path` with compression `c` (`automatic` is resolved from the file name),
+ * compressed output is compressed on a background thread
+ */
+inline auto open_sink(const std::string &path, compression c) -> std::unique_ptr<byte_sink>
+{
+    switch (resolve_compression(path, c)) {
+    case compression::gzip:
+#if defined(TFS_CPP_ZLIB)
+        return std::make_unique<threaded_sink>(std::make_unique<gzip_sink>(path));
+#else
+        throw std::runtime_error("tfs_cpp was built without zlib, cannot write " + path);
+#endif
+    case compression::zstd:
+#if defined(TFS_CPP_ZSTD)
+        return std::make_unique<threaded_sink>(std::make_unique<zstd_sink>(path));
+#else
+        throw std::runtime_error("tfs_cpp was built without zstd, cannot write " + path);
+#endif
+    default:
+        return std::make_unique<file_sink>(path);
+    }
+}
+
+}// namespace tfs
@@ -1,17 +1,49 @@
 #pragma once
 
+#include <algorithm>
 #include <complex>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
+#include "bit_column.h"
+#include "complex_column.h"
+#include "format.h"
+#include "parse.h"
+#include "string_column.h"
+
 namespace tfs {
 constexpr int FIELDWIDTH = 15;
 
+/// row number that `data_vector::gather_or_missing` turns into a missing value
+constexpr size_t MISSING_ROW = static_cast<size_t>(-1);
+
+/**
+ * @brief Rows `[begin, end)` of a column, an `end` past the column means up to its end
+ */
+struct row_range
+{
+    size_t begin = 0;
+    size_t end = static_cast<size_t>(-1);
+
+    /// the range within a column of `n` rows
+    [[nodiscard]] auto clamp(size_t n) const -> row_range
+    {
+        const size_t e = std::min(end, n);
+        return { std::min(begin, e), e };
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return end - begin; }
+};
+
 enum DataType {
     S,// string
     LE,// float (double)
@@ -30,8 +62,13 @@ template<typename real> struct data_value
     data_value(double d) : type(DataType::LE), payload(d) {}
     data_value(bool b) : type(DataType::B), payload(b) {}
     data_value(const std::string &s) : type(DataType::S), payload(s) {}
+    data_value(std::complex<real> c) : type(DataType::C), payload(c) {}
 
     data_value(data_value<real> &&other) : type(other.type), payload(std::move(other.payload)) {}
+    data_value(const data_value<real> &other) : type(other.type), payload(other.payload) {}
+
+    data_value &operator=(data_value<real> &&other) = default;
+    data_value &operator=(const data_value<real> &other) = default;
 
     template<typename U> data_value(const data_value<U> &other) : type(other.type), payload(other.payload) {}
 
@@ -84,19 +121,39 @@ template<typename real> struct data_value
     }
 };
 
-template<typename real> struct data_vector
+/**
+ * @brief One column, a `%le`, `%d`, `%s`, `%b` or `%lec` payload behind a type tag.
+ *
+ * `%le`, `%d` and (non-compact) `%s` columns, including every string cell, allocate through
+ * `Alloc`, e.g. `std::pmr::polymorphic_allocator<char>` to place them in a memory resource. The
+ * other layouts use a handful of allocations per column and stay on the default heap. With the
+ * default `std::allocator` the payloads are plain `std::vector<real>`, `std::vector<int>` and
+ * `std::vector<std::string>`.
+ */
+template<typename real, typename Alloc = std::allocator<char>> struct data_vector
 {
-    union udata_vec {
-        std::vector<std::string> string_vector;
-        std::vector<real> double_vector;
-        std::vector<int> int_vector;
-        std::vector<bool> bool_vector;
+    template<typename T> using allocator_for = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+    using allocator_type = Alloc;
+    using string_type = std::basic_string<char, std::char_traits<char>, allocator_for<char>>;
+    using string_vector_type = std::vector<string_type, allocator_for<string_type>>;
+    using real_vector_type = std::vector<real, allocator_for<real>>;
+    using int_vector_type = std::vector<int, allocator_for<int>>;
 
-        udata_vec() : string_vector() {}// does nothing, construction is handled by parent
+    union udata_vec {
+        string_vector_type string_vector;
+        real_vector_type double_vector;
+        int_vector_type int_vector;
+        bit_column bool_column;
+        string_column string_arena;
+        split_complex<real> complex_vector;
+
+        udata_vec() {}// does nothing, construction is handled by parent
         ~udata_vec() {}// does nothing, destruction is handled by parent
     } payload;
     DataType type;
     std::string name;
+    /// `%s` column stored contiguously in `payload.string_arena` instead of `payload.string_vector`
+    bool compact = false;
 
     // ----------------------------------------------------------------------------------------
     // ---- Init ------------------------------------------------------------------------------
@@ -106,49 +163,67 @@ template<typename real> struct data_vector
      *
      * @param t
      * @param s
+     * @param alloc allocator of `%le`, `%d` and `%s` payloads
      */
-    data_vector(DataType t, const std::string &s) : type(t), name(s)
+    data_vector(DataType t, const std::string &s, const Alloc &alloc = Alloc()) : type(t), name(s)
     {
-
-        payload.~udata_vec();// get rid of the default string_vec inside;
         switch (t) {
         case DataType::B:
+            new (&payload.bool_column) bit_column();
             break;
         case DataType::LE:
-            payload.double_vector = std::vector<real>();
+            new (&payload.double_vector) real_vector_type(allocator_for<real>(alloc));
             break;
         case DataType::D:
-            payload.int_vector = std::vector<int>();
+            new (&payload.int_vector) int_vector_type(allocator_for<int>(alloc));
             break;
         case DataType::S:
-            payload.string_vector = std::vector<std::string>();
+            new (&payload.string_vector) string_vector_type(allocator_for<string_type>(alloc));
             break;
         case DataType::C:
-            throw std::runtime_error("complex datatype not yet supported");
+            new (&payload.complex_vector) split_complex<real>();
             break;
         }
     }
 
+    /**
+     * @brief Construct a string column with contiguous storage, see `string_column`
+     *
+     * @param s
+     * @param encoding
+     */
+    data_vector(const std::string &s, string_encoding encoding) : type(DataType::S), name(s), compact(true)
+    {
+        new (&payload.string_arena) string_column(encoding);
+    }
+
     /**
      * @brief Move construct
      *
      * @param other
      */
-    data_vector(data_vector &&other) noexcept : type(std::move(other.type)), name(std::move(other.name))
+    data_vector(data_vector &&other) noexcept
+        : type(std::move(other.type)), name(std::move(other.name)), compact(other.compact)
     {
 
         switch (other.type) {
         case DataType::B:
-            payload.bool_vector = std::move(other.payload.bool_vector);
+            new (&payload.bool_column) bit_column(std::move(other.payload.bool_column));
             break;
         case DataType::LE:
-            payload.double_vector = std::move(other.payload.double_vector);
+            new (&payload.double_vector) real_vector_type(std::move(other.payload.double_vector));
             break;
         case DataType::D:
-            payload.int_vector = std::move(other.payload.int_vector);
+            new (&payload.int_vector) int_vector_type(std::move(other.payload.int_vector));
             break;
         case DataType::S:
-            payload.string_vector = std::move(other.payload.string_vector);
+            if (compact)
+                new (&payload.string_arena) string_column(std::move(other.payload.string_arena));
+            else
+                new (&payload.string_vector) string_vector_type(std::move(other.payload.string_vector));
+            break;
+        case DataType::C:
+            new (&payload.complex_vector) split_complex<real>(std::move(other.payload.complex_vector));
             break;
         }
     }
@@ -158,21 +233,27 @@ template<typename real> struct data_vector
      *
      * @param other
      */
-    data_vector(const data_vector &other) : type(other.type), name(other.name)
+    data_vector(const data_vector &other) : type(other.type), name(other.name), compact(other.compact)
     {
 
         switch (other.type) {
         case DataType::B:
-            payload.bool_vector = other.payload.bool_vector;
+            new (&payload.bool_column) bit_column(other.payload.bool_column);
             break;
         case DataType::LE:
-            payload.double_vector = other.payload.double_vector;
+            new (&payload.double_vector) real_vector_type(other.payload.double_vector);
             break;
         case DataType::D:
-            payload.int_vector = other.payload.int_vector;
+            new (&payload.int_vector) int_vector_type(other.payload.int_vector);
             break;
         case DataType::S:
-            payload.string_vector = other.payload.string_vector;
+            if (compact)
+                new (&payload.string_arena) string_column(other.payload.string_arena);
+            else
+                new (&payload.string_vector) string_vector_type(other.payload.string_vector);
+            break;
+        case DataType::C:
+            new (&payload.complex_vector) split_complex<real>(other.payload.complex_vector);
             break;
         }
     }
@@ -181,7 +262,7 @@ template<typename real> struct data_vector
     {
         switch (type) {
         case DataType::B:
-            payload.bool_vector.~vector();
+            payload.bool_column.~bit_column();
             break;
         case DataType::D:
             payload.int_vector.~vector();
@@ -190,38 +271,159 @@ template<typename real> struct data_vector
             payload.double_vector.~vector();
             break;
         case DataType::S:
-            payload.string_vector.~vector();
+            if (compact)
+                payload.string_arena.~string_column();
+            else
+                payload.string_vector.~vector();
+            break;
+        case DataType::C:
+            payload.complex_vector.~split_complex();
             break;
         }
     }
 
+    /**
+     * @brief Converts a `%s` column to contiguous `string_column` storage, keeping its values
+     */
+    void make_compact(string_encoding encoding = string_encoding::automatic)
+    {
+        if (type != DataType::S) throw std::runtime_error("this is not a string vector");
+        if (compact) return;
+
+        string_column strings(encoding);
+        strings.reserve(payload.string_vector.size());
+        for (auto &str : payload.string_vector) strings.push_back(str);
+
+        payload.string_vector.~vector();
+        new (&payload.string_arena) string_column(std::move(strings));
+        compact = true;
+    }
+
     // ----------------------------------------------------------------------------------------
     // ---- Insertion -------------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
 
     /**
      * @brief Converts `s` into the datatype of the current data_vector
+     *
+     * `s` does not need to be NUL-terminated, so tokens can point straight into a file buffer. Only
+     * string cells allocate.
+     */
+    void convert_back(std::string_view s)
+    {
+        switch (type) {
+        case DataType::D:
+            payload.int_vector.push_back(parse_int(s));
+            break;
+        case DataType::LE:
+            payload.double_vector.push_back(parse_real<real>(s));
+            break;
+        case DataType::S:
+            if (compact)
+                payload.string_arena.push_back(s);
+            else
+                payload.string_vector.emplace_back(s);
+            break;
+        case DataType::B:
+            payload.bool_column.push_back(parse_bool(s));
+            break;
+        case DataType::C:
+            payload.complex_vector.push_back(parse_complex<real>(s));
+            break;
+        }
+    }
+
+    /**
+     * @brief Moves all elements of `other` to the end of this vector, both need to have the same type
+     */
+    void append(data_vector &&other)
+    {
+        if (type != other.type) throw std::runtime_error("cannot append a data_vector of different type");
+        if (compact != other.compact) throw std::runtime_error("cannot append a data_vector of different storage");
+        switch (type) {
+        case DataType::B:
+            payload.bool_column.append(other.payload.bool_column);
+            break;
+        case DataType::LE:
+            payload.double_vector.insert(
+                payload.double_vector.end(), other.payload.double_vector.begin(), other.payload.double_vector.end());
+            break;
+        case DataType::D:
+            payload.int_vector.insert(
+                payload.int_vector.end(), other.payload.int_vector.begin(), other.payload.int_vector.end());
+            break;
+        case DataType::S:
+            if (compact) {
+                payload.string_arena.append(std::move(other.payload.string_arena));
+                break;
+            }
+            payload.string_vector.insert(payload.string_vector.end(),
+                std::make_move_iterator(other.payload.string_vector.begin()),
+                std::make_move_iterator(other.payload.string_vector.end()));
+            break;
+        case DataType::C:
+            payload.complex_vector.append(other.payload.complex_vector);
+            break;
+        }
+    }
+
+    /**
+     * @brief Removes all elements, keeping the allocated storage for reuse
      */
-    void convert_back(const std::string &s)
+    void clear()
     {
-        char *end;
         switch (type) {
+        case DataType::B:
+            payload.bool_column.clear();
+            break;
+        case DataType::LE:
+            payload.double_vector.clear();
+            break;
         case DataType::D:
-            push_back(static_cast<int>(strtol(s.c_str(), &end, 10)));
+            payload.int_vector.clear();
+            break;
+        case DataType::S:
+            if (compact)
+                payload.string_arena.clear();
+            else
+                payload.string_vector.clear();
+            break;
+        case DataType::C:
+            payload.complex_vector.clear();
+            break;
+        }
+    }
+
+    /**
+     * @brief Reserves space for `n` elements
+     */
+    void reserve(size_t n)
+    {
+        switch (type) {
+        case DataType::B:
+            payload.bool_column.reserve(n);
             break;
         case DataType::LE:
-            push_back(strtod(s.c_str(), &end));
+            payload.double_vector.reserve(n);
+            break;
+        case DataType::D:
+            payload.int_vector.reserve(n);
             break;
         case DataType::S:
-            push_back(s);
+            if (compact)
+                payload.string_arena.reserve(n);
+            else
+                payload.string_vector.reserve(n);
+            break;
+        case DataType::C:
+            payload.complex_vector.reserve(n);
             break;
         }
     }
 
     void push_back(bool b)
     {
-        if (type != DataType::B) throw std::runtime_error("this is not a bool vector");
-        payload.bool_vector.push_back(b);
+        as_bool_column_mut().push_back(b);
     }
 
     void push_back(int i) { as_int_vector_mut().push_back(i); }
@@ -230,51 +432,212 @@ template<typename real> struct data_vector
 
     void push_back(float d) { push_back(static_cast<double>(d)); }
 
-    void push_back(const std::string &s) { as_string_vector_mut().push_back(s); }
+    void push_back(const std::string &s) { as_string_vector_mut().emplace_back(s); }
+
+    void push_back(std::complex<real> c) { as_complex_vector_mut().push_back(c); }
 
     // ----------------------------------------------------------------------------------------
     // ---- Extraction ------------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
 
-    [[nodiscard]] auto as_real_vector() const -> std::vector<real> const &
+    [[nodiscard]] auto as_real_vector() const -> real_vector_type const &
     {
         if (type != DataType::LE) throw std::runtime_error("this is not a double vector");
         return payload.double_vector;
     }
 
-    [[nodiscard]] auto as_string_vector() const -> std::vector<std::string> const &
+    [[nodiscard]] auto as_string_vector() const -> string_vector_type const &
     {
         if (type != DataType::S) throw std::runtime_error("this is not a string vector");
+        if (compact) throw std::runtime_error("this is a compact string vector, use as_string_column");
         return payload.string_vector;
     }
 
-    [[nodiscard]] auto as_int_vector() const -> std::vector<int> const &
+    [[nodiscard]] auto as_string_column() const -> string_column const &
+    {
+        if (type != DataType::S || !compact) throw std::runtime_error("this is not a compact string vector");
+        return payload.string_arena;
+    }
+
+    /**
+     * @brief The i-th element of a string column, for both storage layouts
+     */
+    [[nodiscard]] auto string_at(size_t i) const -> std::string_view
+    {
+        if (type != DataType::S) throw std::runtime_error("this is not a string vector");
+        if (compact) return payload.string_arena[i];
+        return payload.string_vector[i];
+    }
+
+    [[nodiscard]] auto as_int_vector() const -> int_vector_type const &
     {
         if (type != DataType::D) throw std::runtime_error("this is not an int vector");
         return payload.int_vector;
     }
 
+    /**
+     * @brief Real and imaginary parts of a complex column, see `split_complex`
+     */
+    [[nodiscard]] auto as_complex_vector() const -> split_complex<real> const &
+    {
+        if (type != DataType::C) throw std::runtime_error("this is not a complex vector");
+        return payload.complex_vector;
+    }
+
+    [[nodiscard]] auto as_complex(size_t i) const -> std::complex<real> { return as_complex_vector()[i]; }
+
+    /**
+     * @brief Bit-packed values of a boolean column, see `bit_column`
+     */
+    [[nodiscard]] auto as_bool_column() const -> bit_column const &
+    {
+        if (type != DataType::B) throw std::runtime_error("this is not a bool vector");
+        return payload.bool_column;
+    }
+
     // ---- and _mut versions -----------------------------------------------------------------
 
-    [[nodiscard]] auto as_real_vector_mut() -> std::vector<real> &
+    [[nodiscard]] auto as_real_vector_mut() -> real_vector_type &
+    {
+        return const_cast<real_vector_type &>(static_cast<data_vector *>(this)->as_real_vector());
+    }
+
+    [[nodiscard]] auto as_string_vector_mut() -> string_vector_type &
     {
-        return const_cast<std::vector<real> &>(static_cast<data_vector<real> *>(this)->as_real_vector());
+        return const_cast<string_vector_type &>(static_cast<data_vector *>(this)->as_string_vector());
     }
 
-    [[nodiscard]] auto as_string_vector_mut() -> std::vector<std::string> &
+    [[nodiscard]] auto as_int_vector_mut() -> int_vector_type &
     {
-        return const_cast<std::vector<std::string> &>(static_cast<data_vector<real> *>(this)->as_string_vector());
+        return const_cast<int_vector_type &>(static_cast<data_vector *>(this)->as_int_vector());
     }
 
-    [[nodiscard]] auto as_int_vector_mut() -> std::vector<int> &
+    [[nodiscard]] auto as_bool_column_mut() -> bit_column &
     {
-        return const_cast<std::vector<int> &>(static_cast<data_vector<real> *>(this)->as_int_vector());
+        return const_cast<bit_column &>(static_cast<data_vector *>(this)->as_bool_column());
+    }
+
+    [[nodiscard]] auto as_complex_vector_mut() -> split_complex<real> &
+    {
+        return const_cast<split_complex<real> &>(static_cast<data_vector *>(this)->as_complex_vector());
+    }
+
+    /**
+     * @brief New column of the same type holding the elements at `rows`, in that order
+     */
+    [[nodiscard]] auto gather(const std::vector<size_t> &rows) const -> data_vector { return gather_rows<false>(rows); }
+
+    /**
+     * @brief New column of the same type holding the rows set in `mask`, in ascending order. The
+     * mask is walked word by word, it is not expanded to a list of rows.
+     */
+    [[nodiscard]] auto gather(const bit_column &mask) const -> data_vector
+    {
+        data_vector out(type, name, get_allocator());
+        if (compact) out.make_compact();
+        const size_t n = mask.count();
+        out.reserve(n);
+        switch (type) {
+        case DataType::B:
+            mask.for_each_set([&](size_t r) { out.payload.bool_column.push_back(payload.bool_column[r]); });
+            break;
+        case DataType::LE: {
+            out.payload.double_vector.resize(n);
+            real *o = out.payload.double_vector.data();
+            const real *v = payload.double_vector.data();
+            mask.for_each_set([&o, v](size_t r) { *o++ = v[r]; });
+            break;
+        }
+        case DataType::D: {
+            out.payload.int_vector.resize(n);
+            int *o = out.payload.int_vector.data();
+            const int *v = payload.int_vector.data();
+            mask.for_each_set([&o, v](size_t r) { *o++ = v[r]; });
+            break;
+        }
+        case DataType::S:
+            mask.for_each_set([&](size_t r) {
+                if (compact)
+                    out.payload.string_arena.push_back(string_at(r));
+                else
+                    out.payload.string_vector.emplace_back(string_at(r));
+            });
+            break;
+        case DataType::C:
+            mask.for_each_set([&](size_t r) { out.payload.complex_vector.push_back(payload.complex_vector[r]); });
+            break;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Like `gather`, but `MISSING_ROW` entries of `rows` become missing values: NaN, 0, false or
+     * an empty quoted string
+     */
+    [[nodiscard]] auto gather_or_missing(const std::vector<size_t> &rows) const -> data_vector
+    {
+        return gather_rows<true>(rows);
+    }
+
+    /**
+     * @brief New column of the same type holding a copy of the rows `[begin, end)`
+     */
+    [[nodiscard]] auto slice(size_t begin, size_t end) const -> data_vector
+    {
+        data_vector out(type, name, get_allocator());
+        if (compact) out.make_compact();
+        out.reserve(end - begin);
+        switch (type) {
+        case DataType::B:
+            for (size_t i = begin; i < end; i++) out.payload.bool_column.push_back(payload.bool_column[i]);
+            break;
+        case DataType::LE: {
+            const auto first = payload.double_vector.begin();
+            out.payload.double_vector.assign(first + begin, first + end);
+            break;
+        }
+        case DataType::D: {
+            const auto first = payload.int_vector.begin();
+            out.payload.int_vector.assign(first + begin, first + end);
+            break;
+        }
+        case DataType::S:
+            for (size_t i = begin; i < end; i++) {
+                if (compact)
+                    out.payload.string_arena.push_back(string_at(i));
+                else
+                    out.payload.string_vector.emplace_back(string_at(i));
+            }
+            break;
+        case DataType::C:
+            for (size_t i = begin; i < end; i++) out.payload.complex_vector.push_back(payload.complex_vector[i]);
+            break;
+        }
+        return out;
     }
 
     // ----------------------------------------------------------------------------------------
     // ---- Properties ------------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
 
+    /**
+     * @brief Allocator of the payload, a default constructed one for layouts that do not use it
+     */
+    [[nodiscard]] auto get_allocator() const -> Alloc
+    {
+        switch (type) {
+        case DataType::LE:
+            return Alloc(payload.double_vector.get_allocator());
+        case DataType::D:
+            return Alloc(payload.int_vector.get_allocator());
+        case DataType::S:
+            if (!compact) return Alloc(payload.string_vector.get_allocator());
+            return Alloc();
+        default:
+            return Alloc();
+        }
+    }
+
     [[nodiscard]] auto size() const -> size_t
     {
         switch (type) {
@@ -285,31 +648,137 @@ template<typename real> struct data_vector
             return payload.double_vector.size();
             break;
         case DataType::S:
-            return payload.string_vector.size();
+            return compact ? payload.string_arena.size() : payload.string_vector.size();
+            break;
+        case DataType::B:
+            return payload.bool_column.size();
             break;
+        case DataType::C:
+            return payload.complex_vector.size();
+            break;
+        default:
+            return 0;
         }
     }
 
-    void print_at(size_t i, std::ostream &os) const
+    /**
+     * @brief Bytes allocated by this column, including heap allocated strings
+     */
+    [[nodiscard]] auto memory_usage() const -> size_t
+    {
+        switch (type) {
+        case DataType::D:
+            return payload.int_vector.capacity() * sizeof(int);
+        case DataType::LE:
+            return payload.double_vector.capacity() * sizeof(real);
+        case DataType::B:
+            return payload.bool_column.memory_usage();
+        case DataType::C:
+            return (payload.complex_vector.re.capacity() + payload.complex_vector.im.capacity()) * sizeof(real);
+        case DataType::S: {
+            if (compact) return payload.string_arena.memory_usage();
+            const size_t sso = string_type().capacity();
+            size_t bytes = payload.string_vector.capacity() * sizeof(string_type);
+            for (auto &str : payload.string_vector) {
+                if (str.capacity() > sso) bytes += str.capacity() + 1;
+            }
+            return bytes;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Appends the i-th element to `out` as a TFS field: right aligned to `FIELDWIDTH`
+     * characters and followed by a space. Numbers use the shortest round-trip representation.
+     */
+    void format_at(size_t i, std::string &out) const
     {
+        char buffer[FORMAT_BUFFER];
         switch (type) {
         case DataType::D:
-            os << std::setw(FIELDWIDTH) << payload.int_vector[i] << " ";
+            append_padded(out, format_int(buffer, payload.int_vector[i]), FIELDWIDTH);
             break;
         case DataType::LE:
-            os << std::setw(FIELDWIDTH) << payload.double_vector[i] << " ";
+            append_padded(out, format_real(buffer, payload.double_vector[i]), FIELDWIDTH);
             break;
         case DataType::S:
-            os << std::setw(FIELDWIDTH) << payload.string_vector[i] << " ";
+            append_padded(out, string_at(i), FIELDWIDTH);
+            break;
+        case DataType::C: {
+            char complex_buffer[COMPLEX_FORMAT_BUFFER];
+            append_padded(out, format_complex(complex_buffer, payload.complex_vector[i]), FIELDWIDTH);
             break;
         }
+        case DataType::B:
+            append_padded(out, payload.bool_column[i] ? "True" : "False", FIELDWIDTH);
+            break;
+        }
+        out.push_back(' ');
+    }
+
+    void print_at(size_t i, std::ostream &os) const
+    {
+        std::string cell;
+        format_at(i, cell);
+        os << cell;
+    }
+
+  private:
+    template<bool missing> auto gather_rows(const std::vector<size_t> &rows) const -> data_vector
+    {
+        data_vector out(type, name, get_allocator());
+        if (compact) out.make_compact();
+        out.reserve(rows.size());
+        switch (type) {
+        case DataType::B:
+            for (auto r : rows) {
+                out.payload.bool_column.push_back((!missing || r != MISSING_ROW) && payload.bool_column[r]);
+            }
+            break;
+        case DataType::LE: {
+            const real nan = std::numeric_limits<real>::quiet_NaN();
+            out.payload.double_vector.resize(rows.size());
+            real *o = out.payload.double_vector.data();
+            const real *v = payload.double_vector.data();
+            for (size_t i = 0; i < rows.size(); i++) o[i] = missing && rows[i] == MISSING_ROW ? nan : v[rows[i]];
+            break;
+        }
+        case DataType::D: {
+            out.payload.int_vector.resize(rows.size());
+            int *o = out.payload.int_vector.data();
+            const int *v = payload.int_vector.data();
+            for (size_t i = 0; i < rows.size(); i++) o[i] = missing && rows[i] == MISSING_ROW ? 0 : v[rows[i]];
+            break;
+        }
+        case DataType::S:
+            for (auto r : rows) {
+                const std::string_view value = missing && r == MISSING_ROW ? std::string_view("\"\"") : string_at(r);
+                if (compact)
+                    out.payload.string_arena.push_back(value);
+                else
+                    out.payload.string_vector.emplace_back(value);
+            }
+            break;
+        case DataType::C: {
+            const real nan = std::numeric_limits<real>::quiet_NaN();
+            for (auto r : rows) {
+                out.payload.complex_vector.push_back(
+                    missing && r == MISSING_ROW ? std::complex<real>(nan, nan) : payload.complex_vector[r]);
+            }
+            break;
+        }
+        }
+        return out;
     }
 };
-inline DataType DT_from_string(const std::string &token)
+inline DataType DT_from_string(std::string_view token)
 {
     if (token == "%d") return DataType::D;
     if (token == "%le") return DataType::LE;
     if (token == "%b") return DataType::B;
+    if (token == "%lec") return DataType::C;
     return DataType::S;// ddefault to S is safe
 }
 inline const char *string_fromDT(DataType t)
@@ -319,6 +788,10 @@ inline const char *string_fromDT(DataType t)
         return "%d";
     case DataType::LE:
         return "%le";
+    case DataType::C:
+        return "%lec";
+    case DataType::B:
+        return "%b";
     default:
         return "%s";
     }
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tfs_dataframe.h"
+
+namespace tfs {
+
+/**
+ * @brief Contiguous values of one column, not owning them
+ */
+template<typename T> class column_span
+{
+  public:
+    column_span(const T *values, size_t n) : values(values), n(n) {}
+
+    [[nodiscard]] auto data() const -> const T * { return values; }
+    [[nodiscard]] auto size() const -> size_t { return n; }
+    [[nodiscard]] auto empty() const -> bool { return n == 0; }
+    auto operator[](size_t i) const -> const T & { return values[i]; }
+    [[nodiscard]] auto begin() const -> const T * { return values; }
+    [[nodiscard]] auto end() const -> const T * { return values + n; }
+
+  private:
+    const T *values;
+    size_t n;
+};
+
+/**
+ * @brief Row range of one column of a `dataframe_view`, row 0 is the first row of the range
+ */
+template<typename real, typename Alloc> class column_view
+{
+  public:
+    using column_type = data_vector<real, Alloc>;
+
+    column_view(const column_type &column, row_range rows) : col(&column), rows(rows) {}
+
+    [[nodiscard]] auto size() const -> size_t { return rows.size(); }
+    [[nodiscard]] auto type() const -> DataType { return col->type; }
+    /// the whole column and the rows of it that are viewed
+    [[nodiscard]] auto column() const -> const column_type & { return *col; }
+    [[nodiscard]] auto range() const -> row_range { return rows; }
+
+    [[nodiscard]] auto as_real_span() const -> column_span<real>
+    {
+        return { col->as_real_vector().data() + rows.begin, rows.size() };
+    }
+
+    [[nodiscard]] auto as_int_span() const -> column_span<int>
+    {
+        return { col->as_int_vector().data() + rows.begin, rows.size() };
+    }
+
+    [[nodiscard]] auto string_at(size_t i) const -> std::string_view { return col->string_at(rows.begin + i); }
+    [[nodiscard]] auto bool_at(size_t i) const -> bool { return col->as_bool_column()[rows.begin + i]; }
+    [[nodiscard]] auto as_complex(size_t i) const -> std::complex<real> { return col->as_complex(rows.begin + i); }
+    void format_at(size_t i, std::string &out) const { col->format_at(rows.begin + i, out); }
+
+  private:
+    const column_type *col;
+    row_range rows;
+};
+
+/**
+ * @brief Non-owning view of a contiguous row range and a subset of the columns of a `dataframe`.
+ *
+ * Creating and slicing views copies no cell. Columns are accessed as spans over the payloads of the
+ * dataframe, and writing, index lookups, summaries and column expressions work on the viewed rows
+ * only. `materialize` makes an owning copy.
+ *
+ * The dataframe has to outlive the view, adding columns or rows to it invalidates the view. Row
+ * numbers of the view count from the first viewed row.
+ */
+template<typename real = double, typename Alloc = std::allocator<char>> class dataframe_view
+{
+  public:
+    using frame_type = dataframe<real, Alloc>;
+    using column_type = data_vector<real, Alloc>;
+
+    /**
+     * @brief All columns of `df` in `rows`
+     */
+    explicit dataframe_view(const dataframe<real, Alloc> &df, row_range rows = {})
+        : df(&df), rows(rows.clamp(df.size()))
+    {
+        for (auto &c : df.column_headers) {
+            names.push_back(c.first);
+            cols.push_back(&df.columns[c.second]);
+        }
+    }
+
+    /**
+     * @brief The columns `columns` of `df` in `rows`. Throws if one of them is not in `df`.
+     */
+    dataframe_view(const dataframe<real, Alloc> &df, std::vector<std::string> columns, row_range rows = {})
+        : df(&df), rows(rows.clamp(df.size())), names(std::move(columns))
+    {
+        // in file order of the dataframe, so that writing gives the same file as the copy would
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        for (auto &name : names) cols.push_back(&df.get_column(name));
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Slicing ---------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief The rows `[begin, end)` of this view
+     */
+    [[nodiscard]] auto slice(size_t begin, size_t end) const -> dataframe_view
+    {
+        dataframe_view out = *this;
+        const auto sub = row_range{ begin, end }.clamp(size());
+        out.rows = { rows.begin + sub.begin, rows.begin + sub.end };
+        return out;
+    }
+
+    /**
+     * @brief The columns `columns` of this view. Throws if one of them is not in the view.
+     */
+    [[nodiscard]] auto select(const std::vector<std::string> &columns) const -> dataframe_view
+    {
+        for (auto &name : columns) (void)column_of(name);
+        return dataframe_view(*df, columns, rows);
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Columns ---------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Number of viewed rows
+     */
+    [[nodiscard]] auto size() const -> size_t { return rows.size(); }
+
+    /**
+     * @brief Viewed rows of the dataframe
+     */
+    [[nodiscard]] auto range() const -> row_range { return rows; }
+
+    /**
+     * @brief Names of the viewed columns, sorted
+     */
+    [[nodiscard]] auto column_names() const -> const std::vector<std::string> & { return names; }
+
+    [[nodiscard]] auto has_column(const std::string &name) const -> bool
+    {
+        return std::binary_search(names.begin(), names.end(), name);
+    }
+
+    /**
+     * @brief The viewed rows of column `name`. Throws if it is not in the view.
+     */
+    [[nodiscard]] auto get_column(const std::string &name) const -> column_view<real, Alloc>
+    {
+        return { *column_of(name), rows };
+    }
+
+    /**
+     * @brief The `%le` column `name` as operand of a column expression, see `expression.h`
+     */
+    [[nodiscard]] auto expr(const std::string &name) const -> column_expr<real>
+    {
+        const auto span = get_column(name).as_real_span();
+        return column_expr<real>(span.data(), span.size());
+    }
+
+    /**
+     * @brief The `%d` column `name` as operand of a column expression
+     */
+    [[nodiscard]] auto int_expr(const std::string &name) const -> column_expr<int>
+    {
+        const auto span = get_column(name).as_int_span();
+        return column_expr<int>(span.data(), span.size());
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Lookups ---------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Row of `key` in the row index of the dataframe, relative to the view. Throws if it is
+     * not in the index or outside the view.
+     */
+    [[nodiscard]] auto get_index(const std::string &key) const -> size_t
+    {
+        const size_t i = find_index(key);
+        if (i == hash_index::npos) throw std::runtime_error("key " + key + " not found in view");
+        return i;
+    }
+
+    /**
+     * @brief Like `get_index`, but `hash_index::npos` if `key` is not among the viewed rows
+     */
+    [[nodiscard]] auto find_index(std::string_view key) const -> size_t
+    {
+        const size_t i = df->find_index(key);
+        if (i == hash_index::npos || i < rows.begin || i >= rows.end) return hash_index::npos;
+        return i - rows.begin;
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Aggregation -----------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief `dataframe::summarize` over the viewed rows
+     */
+    [[nodiscard]] auto summarize(const std::string &column, size_t threads = 1) const -> summary
+    {
+        return tfs::summarize(*column_of(column), threads, rows);
+    }
+
+    [[nodiscard]] auto summarize(const std::vector<std::string> &columns, size_t threads = 1) const
+        -> std::vector<summary>
+    {
+        return tfs::summarize(column_pointers(columns), threads, rows);
+    }
+
+    [[nodiscard]] auto summarize(std::initializer_list<std::string> columns, size_t threads = 1) const
+        -> std::vector<summary>
+    {
+        return summarize(std::vector<std::string>(columns), threads);
+    }
+
+    /**
+     * @brief `dataframe::summarize_by` over the viewed rows
+     */
+    [[nodiscard]] auto summarize_by(const std::string &key, const std::vector<std::string> &columns, size_t threads = 1)
+        const -> grouped_summary
+    {
+        return tfs::summarize_by(*column_of(key), column_pointers(columns), threads, rows);
+    }
+
+    template<typename KeyOf>
+    [[nodiscard]] auto summarize_by(const std::string &key,
+        KeyOf &&key_of,
+        const std::vector<std::string> &columns,
+        size_t threads = 1) const -> grouped_summary
+    {
+        return tfs::summarize_by(
+            *column_of(key), std::forward<KeyOf>(key_of), column_pointers(columns), threads, rows);
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Output ----------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Writes the properties of the dataframe and the viewed columns and rows, like
+     * `dataframe::to_file` does, without copying them first
+     */
+    void to_file(const std::string &filename, const write_options &options = {}) const
+    {
+        df->write_rows(filename, options, names, cols, rows.begin, rows.end);
+    }
+
+    /**
+     * @brief Copies the viewed columns and rows into a new dataframe with the properties of the
+     * original. Like with `dataframe::select` the row index is not carried over. With `threads`
+     * other than 1 the columns are copied concurrently.
+     */
+    [[nodiscard]] auto materialize(size_t threads = 1) const -> frame_type
+    {
+        frame_type out(df->allocator.alloc);
+        out.properties = df->properties;
+        for (size_t c = 0; c < names.size(); c++) out.column_headers.emplace(names[c], c);
+        out.columns = frame_type::gather_columns(
+            cols.size(), [this](size_t c) { return cols[c]->slice(rows.begin, rows.end); }, threads);
+        for (size_t c = 0; c < names.size(); c++) out.columns[c].name = names[c];
+        out.index_columns();
+        out.ini_complete = true;
+        return out;
+    }
+
+  private:
+    auto column_of(const std::string &name) const -> const column_type *
+    {
+        const auto it = std::lower_bound(names.begin(), names.end(), name);
+        if (it == names.end() || *it != name) throw std::runtime_error("column " + name + " is not part of the view");
+        return cols[static_cast<size_t>(it - names.begin())];
+    }
+
+    auto column_pointers(const std::vector<std::string> &columns) const -> std::vector<const column_type *>
+    {
+        std::vector<const column_type *> out;
+        out.reserve(columns.size());
+        for (auto &name : columns) out.push_back(column_of(name));
+        return out;
+    }
+
+    const frame_type *df;
+    row_range rows;
+    /// viewed columns in the order they are written, `cols[i]` is named `names[i]`
+    std::vector<std::string> names;
+    std::vector<const column_type *> cols;
+};
+
+}// namespace tfs
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace tfs {
+
+// ----------------------------------------------------------------------------------------
+// ---- Column expressions ----------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// Arithmetic and math functions on `column_expr`s do not compute anything, they build an expression
+// whose type is the tree of operations:
+//
+//     auto beating = (twiss.expr("BETX") - model.expr("BETX")) / model.expr("BETX");
+//
+// is a `binary_expr<divides, binary_expr<minus, column_expr, column_expr>, column_expr>` holding
+// three column pointers. `evaluate` (or `dataframe::add_column`) then runs a single loop over the
+// rows that computes the whole tree per row, with every operation inlined, so the loop vectorizes
+// like a hand-written one and no temporary column is allocated. Long expressions are split into
+// tasks of `EXPRESSION_TASK` rows for several threads.
+//
+// Values follow the C++ arithmetic rules: `%d` columns (`int_expr`) stay `int` until they meet a
+// floating point operand, so dividing two of them divides integers.
+//
+// Expressions refer to the column data, which has to outlive them and must not be resized.
+
+/// rows per task when evaluating on several threads
+constexpr size_t EXPRESSION_TASK = 1 << 16;
+
+/// size of an operand that is the same for every row
+constexpr size_t BROADCAST = std::numeric_limits<size_t>::max();
+
+/**
+ * @brief Base of every expression node, `E` is the node itself
+ */
+template<typename E> struct expression
+{
+    [[nodiscard]] auto self() const -> const E & { return static_cast<const E &>(*this); }
+};
+
+/**
+ * @brief Leaf referring to `n` contiguous values, usually the data of a column
+ */
+template<typename T> class column_expr : public expression<column_expr<T>>
+{
+  public:
+    column_expr(const T *data, size_t n) : values(data), n(n) {}
+
+    template<typename A> explicit column_expr(const std::vector<T, A> &v) : column_expr(v.data(), v.size()) {}
+
+    auto operator[](size_t i) const -> T { return values[i]; }
+    [[nodiscard]] auto size() const -> size_t { return n; }
+
+  private:
+    const T *values;
+    size_t n;
+};
+
+/**
+ * @brief Leaf with the same value in every row
+ */
+template<typename T> class scalar_expr : public expression<scalar_expr<T>>
+{
+  public:
+    explicit scalar_expr(T value) : value(value) {}
+
+    auto operator[](size_t) const -> T { return value; }
+    [[nodiscard]] auto size() const -> size_t { return BROADCAST; }
+
+  private:
+    T value;
+};
+
+/**
+ * @brief `Op` applied to the values of one expression
+ */
+template<typename Op, typename E> class unary_expr : public expression<unary_expr<Op, E>>
+{
+  public:
+    explicit unary_expr(const E &e) : e(e) {}
+
+    auto operator[](size_t i) const { return Op{}(e[i]); }
+    [[nodiscard]] auto size() const -> size_t { return e.size(); }
+
+  private:
+    E e;
+};
+
+/**
+ * @brief `Op` applied row by row to the values of two expressions of the same length
+ */
+template<typename Op, typename L, typename R> class binary_expr : public expression<binary_expr<Op, L, R>>
+{
+  public:
+    binary_expr(const L &l, const R &r) : l(l), r(r), n(std::min(l.size(), r.size()))
+    {
+        if (l.size() != r.size() && l.size() != BROADCAST && r.size() != BROADCAST) {
+            throw std::runtime_error("expression operands have " + std::to_string(l.size()) + " and "
+                                     + std::to_string(r.size()) + " rows");
+        }
+    }
+
+    auto operator[](size_t i) const { return Op{}(l[i], r[i]); }
+    [[nodiscard]] auto size() const -> size_t { return n; }
+
+  private:
+    L l;
+    R r;
+    size_t n;
+};
+
+namespace detail {
+
+    template<typename T> struct is_expression : std::is_base_of<expression<T>, T>
+    {
+    };
+
+    template<typename T> constexpr bool is_operand_v = is_expression<T>::value || std::is_arithmetic_v<T>;
+
+    /// both are expressions or scalars and at least one is an expression
+    template<typename L, typename R>
+    using enable_binary_t =
+        std::enable_if_t<is_operand_v<L> && is_operand_v<R> && (is_expression<L>::value || is_expression<R>::value)>;
+
+    template<typename T> auto as_operand(const T &value)
+    {
+        if constexpr (is_expression<T>::value)
+            return value;
+        else
+            return scalar_expr<T>(value);
+    }
+
+    template<typename Op, typename L, typename R> auto make_binary(const L &l, const R &r)
+    {
+        auto lhs = as_operand(l);
+        auto rhs = as_operand(r);
+        return binary_expr<Op, decltype(lhs), decltype(rhs)>(lhs, rhs);
+    }
+
+    struct negate_op
+    {
+        template<typename T> auto operator()(T x) const { return -x; }
+    };
+    struct plus_op
+    {
+        template<typename A, typename B> auto operator()(A a, B b) const { return a + b; }
+    };
+    struct minus_op
+    {
+        template<typename A, typename B> auto operator()(A a, B b) const { return a - b; }
+    };
+    struct multiplies_op
+    {
+        template<typename A, typename B> auto operator()(A a, B b) const { return a * b; }
+    };
+    struct divides_op
+    {
+        template<typename A, typename B> auto operator()(A a, B b) const { return a / b; }
+    };
+
+}// namespace detail
+
+template<typename E> auto operator-(const expression<E> &e) { return unary_expr<detail::negate_op, E>(e.self()); }
+
+template<typename L, typename R, typename = detail::enable_binary_t<L, R>> auto operator+(const L &l, const R &r)
+{
+    return detail::make_binary<detail::plus_op>(l, r);
+}
+
+template<typename L, typename R, typename = detail::enable_binary_t<L, R>> auto operator-(const L &l, const R &r)
+{
+    return detail::make_binary<detail::minus_op>(l, r);
+}
+
+template<typename L, typename R, typename = detail::enable_binary_t<L, R>> auto operator*(const L &l, const R &r)
+{
+    return detail::make_binary<detail::multiplies_op>(l, r);
+}
+
+template<typename L, typename R, typename = detail::enable_binary_t<L, R>> auto operator/(const L &l, const R &r)
+{
+    return detail::make_binary<detail::divides_op>(l, r);
+}
+
+// ---- Math functions ----
+//
+// Each function of <cmath> below is available on expressions under the same name.
+
+/// unary function `NAME` of <cmath> on an expression
+#define TFS_EXPRESSION_UNARY(NAME)                                                           \
+    namespace detail {                                                                       \
+        struct NAME##_op                                                                     \
+        {                                                                                    \
+            template<typename T> auto operator()(T x) const { return std::NAME(x); }         \
+        };                                                                                   \
+    }                                                                                        \
+    template<typename E> auto NAME(const expression<E> &e)                                   \
+    {                                                                                        \
+        return unary_expr<detail::NAME##_op, E>(e.self());                                   \
+    }
+
+/// binary function `NAME` of <cmath> on two expressions or an expression and a scalar
+#define TFS_EXPRESSION_BINARY(NAME)                                                          \
+    namespace detail {                                                                       \
+        struct NAME##_op                                                                     \
+        {                                                                                    \
+            template<typename A, typename B> auto operator()(A a, B b) const                 \
+            {                                                                                \
+                return std::NAME(a, b);                                                      \
+            }                                                                                \
+        };                                                                                   \
+    }                                                                                        \
+    template<typename L, typename R, typename = detail::enable_binary_t<L, R>>               \
+    auto NAME(const L &l, const R &r)                                                        \
+    {                                                                                        \
+        return detail::make_binary<detail::NAME##_op>(l, r);                                 \
+    }
+
+TFS_EXPRESSION_UNARY(abs)
+TFS_EXPRESSION_UNARY(sqrt)
+TFS_EXPRESSION_UNARY(exp)
+TFS_EXPRESSION_UNARY(log)
+TFS_EXPRESSION_UNARY(sin)
+TFS_EXPRESSION_UNARY(cos)
+TFS_EXPRESSION_UNARY(tan)
+TFS_EXPRESSION_UNARY(asin)
+TFS_EXPRESSION_UNARY(acos)
+TFS_EXPRESSION_UNARY(atan)
+TFS_EXPRESSION_BINARY(pow)
+TFS_EXPRESSION_BINARY(atan2)
+TFS_EXPRESSION_BINARY(hypot)
+TFS_EXPRESSION_BINARY(fmin)
+TFS_EXPRESSION_BINARY(fmax)
+
+#undef TFS_EXPRESSION_UNARY
+#undef TFS_EXPRESSION_BINARY
+
+// ---- Evaluation ----
+
+/**
+ * @brief Computes `e` into `out`, which has room for `e.size()` values, in one pass per row range.
+ * With `threads` other than 1 (0: all hardware threads) ranges of `EXPRESSION_TASK` rows are
+ * computed concurrently.
+ */
+template<typename real, typename E> void evaluate_into(const expression<E> &e, real *out, size_t threads = 1)
+{
+    const E &expr = e.self();
+    const size_t n = expr.size();
+    if (n == BROADCAST) throw std::runtime_error("an expression needs at least one column");
+
+    const size_t tasks = (n + EXPRESSION_TASK - 1) / EXPRESSION_TASK;
+    detail::run_tasks(tasks, threads, [&expr, out, n](size_t t) {
+        const size_t end = std::min(n, (t + 1) * EXPRESSION_TASK);
+        for (size_t i = t * EXPRESSION_TASK; i < end; i++) out[i] = static_cast<real>(expr[i]);
+    });
+}
+
+/**
+ * @brief Computes `e` into a new vector
+ */
+template<typename real = double, typename E> auto evaluate(const expression<E> &e, size_t threads = 1)
+    -> std::vector<real>
+{
+    if (e.self().size() == BROADCAST) throw std::runtime_error("an expression needs at least one column");
+    std::vector<real> out(e.self().size());
+    evaluate_into(e, out.data(), threads);
+    return out;
+}
+
+}// namespace tfs
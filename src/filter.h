@@ -0,0 +1,155 @@
+#pragma once
+
+#include <functional>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bit_column.h"
+#include "data.h"
+
+namespace tfs {
+
+enum class compare_op {
+    lt,// <
+    le,// <=
+    gt,// >
+    ge,// >=
+    eq,// ==
+    ne,// !=
+};
+
+// ----------------------------------------------------------------------------------------
+// ---- Filter kernels --------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// Every kernel evaluates a predicate over a whole column into a `bit_column` mask. Masks combine
+// with `&`, `|` and `~` and select rows through `dataframe::select`.
+
+namespace detail {
+
+    template<typename T, typename A, typename V, typename Cmp>
+    auto compare_values(const std::vector<T, A> &v, V value, Cmp cmp) -> bit_column
+    {
+        const T *data = v.data();
+        return bit_column::from_predicate(
+            v.size(), [data, value, cmp](size_t i) { return cmp(static_cast<V>(data[i]), value); });
+    }
+
+    /**
+     * @brief Compares every element of `v`, converted to `V`, with `value`
+     */
+    template<typename T, typename A, typename V>
+    auto compare_values(const std::vector<T, A> &v, compare_op op, V value) -> bit_column
+    {
+        // one instantiation per operator keeps the comparison out of the inner loop
+        switch (op) {
+        case compare_op::lt:
+            return compare_values(v, value, std::less<V>());
+        case compare_op::le:
+            return compare_values(v, value, std::less_equal<V>());
+        case compare_op::gt:
+            return compare_values(v, value, std::greater<V>());
+        case compare_op::ge:
+            return compare_values(v, value, std::greater_equal<V>());
+        case compare_op::eq:
+            return compare_values(v, value, std::equal_to<V>());
+        case compare_op::ne:
+            return compare_values(v, value, std::not_equal_to<V>());
+        }
+        throw std::runtime_error("unknown comparison");
+    }
+
+    /**
+     * @brief Evaluates `pred` on the values of a string column. Dictionary encoded columns evaluate
+     * it once per distinct value and look the result up by code.
+     */
+    template<typename real, typename Alloc, typename Pred>
+    auto string_mask(const data_vector<real, Alloc> &col, Pred &&pred) -> bit_column
+    {
+        if (col.type != DataType::S) throw std::runtime_error("column " + col.name + " is not a string column");
+
+        if (col.compact && col.as_string_column().is_dictionary()) {
+            const auto &strings = col.as_string_column();
+            std::vector<uint8_t> hit(strings.cardinality());
+            for (uint32_t c = 0; c < hit.size(); c++) hit[c] = pred(strings.dictionary_value(c));
+            return bit_column::from_predicate(strings.size(), [&](size_t i) { return hit[strings.code(i)]; });
+        }
+        return bit_column::from_predicate(col.size(), [&](size_t i) { return pred(col.string_at(i)); });
+    }
+
+}// namespace detail
+
+/**
+ * @brief Rows where `col op value`, for `%le` and `%d` columns
+ */
+template<typename real, typename Alloc>
+auto compare(const data_vector<real, Alloc> &col, compare_op op, double value) -> bit_column
+{
+    switch (col.type) {
+    case DataType::LE:
+        return detail::compare_values(col.as_real_vector(), op, static_cast<real>(value));
+    case DataType::D:
+        return detail::compare_values(col.as_int_vector(), op, value);
+    default:
+        throw std::runtime_error("column " + col.name + " is not numeric");
+    }
+}
+
+/**
+ * @brief Rows where `lo <= col <= hi`, for `%le` and `%d` columns
+ */
+template<typename real, typename Alloc>
+auto between(const data_vector<real, Alloc> &col, double lo, double hi) -> bit_column
+{
+    switch (col.type) {
+    case DataType::LE: {
+        const real *data = col.as_real_vector().data();
+        const auto l = static_cast<real>(lo);
+        const auto h = static_cast<real>(hi);
+        return bit_column::from_predicate(col.size(), [=](size_t i) { return (data[i] >= l) & (data[i] <= h); });
+    }
+    case DataType::D: {
+        const int *data = col.as_int_vector().data();
+        return bit_column::from_predicate(col.size(), [=](size_t i) {
+            const auto x = static_cast<double>(data[i]);
+            return (x >= lo) & (x <= hi);
+        });
+    }
+    default:
+        throw std::runtime_error("column " + col.name + " is not numeric");
+    }
+}
+
+/**
+ * @brief Rows of a string column equal to `value`
+ */
+template<typename real, typename Alloc>
+auto equals(const data_vector<real, Alloc> &col, std::string_view value) -> bit_column
+{
+    return detail::string_mask(col, [value](std::string_view s) { return s == value; });
+}
+
+/**
+ * @brief Rows of a string column starting with `prefix`
+ */
+template<typename real, typename Alloc>
+auto starts_with(const data_vector<real, Alloc> &col, std::string_view prefix) -> bit_column
+{
+    return detail::string_mask(col, [prefix](std::string_view s) { return s.substr(0, prefix.size()) == prefix; });
+}
+
+/**
+ * @brief Rows of a string column containing a match of `pattern`, anchor it with `^`/`$` to match
+ * whole values
+ */
+template<typename real, typename Alloc>
+auto matches(const data_vector<real, Alloc> &col, const std::regex &pattern) -> bit_column
+{
+    return detail::string_mask(
+        col, [&pattern](std::string_view s) { return std::regex_search(s.data(), s.data() + s.size(), pattern); });
+}
+
+}// namespace tfs
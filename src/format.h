@@ -0,0 +1,75 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace tfs {
+
+/// big enough for the shortest round-trip representation of any double
+constexpr size_t FORMAT_BUFFER = 32;
+
+/**
+ * @brief Formats the shortest representation of `value` that parses back to the same value.
+ *
+ * @return view into `buffer`
+ */
+template<typename real> auto format_real(char (&buffer)[FORMAT_BUFFER], real value) -> std::string_view
+{
+#if defined(__cpp_lib_to_chars)
+    const auto result = std::to_chars(buffer, buffer + FORMAT_BUFFER, value);
+    return { buffer, static_cast<size_t>(result.ptr - buffer) };
+#else
+    const int digits = std::is_same_v<real, float> ? 9 : 17;
+    const int n = std::snprintf(buffer, FORMAT_BUFFER, "%.*g", digits, static_cast<double>(value));
+    return { buffer, static_cast<size_t>(n) };
+#endif
+}
+
+inline auto format_int(char (&buffer)[FORMAT_BUFFER], int value) -> std::string_view
+{
+    const auto result = std::to_chars(buffer, buffer + FORMAT_BUFFER, value);
+    return { buffer, static_cast<size_t>(result.ptr - buffer) };
+}
+
+/// big enough for a complex number formatted by `format_complex`
+constexpr size_t COMPLEX_FORMAT_BUFFER = 2 * FORMAT_BUFFER + 2;
+
+/**
+ * @brief Formats `value` as `re+imj` (`re-imj` for negative imaginary parts), which is what Python
+ * and tfs-pandas read back. Both parts use the shortest round-trip representation.
+ *
+ * @return view into `buffer`
+ */
+template<typename real>
+auto format_complex(char (&buffer)[COMPLEX_FORMAT_BUFFER], std::complex<real> value) -> std::string_view
+{
+    char part[FORMAT_BUFFER];
+    size_t n = 0;
+    const auto re = format_real(part, value.real());
+    re.copy(buffer, re.size());
+    n += re.size();
+
+    const real imag = value.imag();
+    buffer[n++] = std::signbit(imag) ? '-' : '+';
+    const auto im = format_real(part, std::signbit(imag) ? -imag : imag);
+    im.copy(buffer + n, im.size());
+    n += im.size();
+    buffer[n++] = 'j';
+    return { buffer, n };
+}
+
+/**
+ * @brief Appends `s` right aligned in a field of `width` characters, like `std::setw` does.
+ */
+inline void append_padded(std::string &out, std::string_view s, size_t width)
+{
+    if (s.size() < width) out.append(width - s.size(), ' ');
+    out.append(s);
+}
+
+}// namespace tfs
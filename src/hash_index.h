@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tfs {
+
+/**
+ * @brief Open-addressing hash map from string keys to row (or column) numbers.
+ *
+ * Keys are copied into one arena, the table holds entry numbers and is probed linearly. The full
+ * hash of every entry is kept so that most mismatches are rejected without touching the key.
+ *
+ * `insert` keeps the first row of a key and records every further occurrence in `duplicates()`.
+ */
+class hash_index
+{
+  public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    hash_index() = default;
+
+    /**
+     * @brief Builds the index over `n` keys, `key(i)` returns the key of row `i`
+     */
+    template<typename KeyFn> static auto build(size_t n, KeyFn &&key) -> hash_index
+    {
+        hash_index index;
+        index.reserve(n);
+        for (size_t i = 0; i < n; i++) index.insert(key(i), i);
+        return index;
+    }
+
+    void reserve(size_t n)
+    {
+        rows.reserve(n);
+        hashes.reserve(n);
+        offsets.reserve(n + 1);
+        size_t capacity = 16;
+        while (capacity < 2 * n) capacity *= 2;
+        if (capacity > slots.size()) rehash(capacity);
+    }
+
+    /**
+     * @brief Adds `key` -> `row`
+     *
+     * @return false if `key` was already present, the first row is kept then
+     */
+    bool insert(std::string_view key, size_t row)
+    {
+        const size_t h = std::hash<std::string_view>{}(key);
+        const size_t slot = probe(key, h);
+        if (slots[slot] != EMPTY) {
+            duplicate_keys.emplace_back(key);
+            return false;
+        }
+        add(slot, key, h, row);
+        return true;
+    }
+
+    /**
+     * @brief Adds `key` -> `row` or points an existing key to `row`
+     */
+    void assign(std::string_view key, size_t row)
+    {
+        const size_t h = std::hash<std::string_view>{}(key);
+        const size_t slot = probe(key, h);
+        if (slots[slot] != EMPTY)
+            rows[slots[slot]] = row;
+        else
+            add(slot, key, h, row);
+    }
+
+    /**
+     * @brief Row of `key`, or `npos`
+     */
+    [[nodiscard]] auto find(std::string_view key) const -> size_t
+    {
+        if (slots.empty()) return npos;
+        const size_t h = std::hash<std::string_view>{}(key);
+        const size_t slot = probe(key, h);
+        return slots[slot] == EMPTY ? npos : rows[slots[slot]];
+    }
+
+    [[nodiscard]] auto contains(std::string_view key) const -> bool { return find(key) != npos; }
+
+    [[nodiscard]] auto size() const -> size_t { return rows.size(); }
+    [[nodiscard]] auto empty() const -> bool { return rows.empty(); }
+
+    /**
+     * @brief Keys that were inserted more than once, once per extra occurrence
+     */
+    [[nodiscard]] auto duplicates() const -> const std::vector<std::string> & { return duplicate_keys; }
+
+    void clear()
+    {
+        arena.clear();
+        offsets.assign(1, 0);
+        rows.clear();
+        hashes.clear();
+        duplicate_keys.clear();
+        std::fill(slots.begin(), slots.end(), EMPTY);
+    }
+
+  private:
+    static constexpr uint32_t EMPTY = static_cast<uint32_t>(-1);
+
+    [[nodiscard]] auto key_of(uint32_t entry) const -> std::string_view
+    {
+        return { arena.data() + offsets[entry], static_cast<size_t>(offsets[entry + 1] - offsets[entry]) };
+    }
+
+    /**
+     * @brief Slot holding `key`, or the empty slot where it would go
+     */
+    [[nodiscard]] auto probe(std::string_view key, size_t h) const -> size_t
+    {
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = h & mask;; slot = (slot + 1) & mask) {
+            const uint32_t entry = slots[slot];
+            if (entry == EMPTY || (hashes[entry] == h && key_of(entry) == key)) return slot;
+        }
+    }
+
+    void add(size_t slot, std::string_view key, size_t h, size_t row)
+    {
+        slots[slot] = static_cast<uint32_t>(rows.size());
+        arena.append(key);
+        offsets.push_back(arena.size());
+        rows.push_back(row);
+        hashes.push_back(h);
+        if (2 * rows.size() > slots.size()) rehash(2 * slots.size());
+    }
+
+    void rehash(size_t n)
+    {
+        slots.assign(n, EMPTY);
+        const size_t mask = n - 1;
+        for (uint32_t entry = 0; entry < rows.size(); entry++) {
+            size_t slot = hashes[entry] & mask;
+            while (slots[slot] != EMPTY) slot = (slot + 1) & mask;
+            slots[slot] = entry;
+        }
+    }
+
+    std::string arena;
+    std::vector<uint64_t> offsets{ 0 };
+    std::vector<size_t> rows;
+    std::vector<size_t> hashes;
+    std::vector<uint32_t> slots = std::vector<uint32_t>(16, EMPTY);
+    std::vector<std::string> duplicate_keys;
+};
+
+}// namespace tfs
@@ -1 +1,7 @@
 #include "tfs_dataframe.h"
+#include "batch_reader.h"
+#include "multi_loader.h"
+#include "typed_dataframe.h"
+#include "position_index.h"
+#include "dataframe_view.h"
+#include "arrow.h"
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tfs {
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The mapping lives as long as the object, `view()` hands out the mapped bytes without copying.
+ * Empty files are valid and yield an empty view.
+ */
+class mapped_file
+{
+  public:
+    explicit mapped_file(const std::string &path) { open(path); }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    mapped_file(mapped_file &&other) noexcept { swap(other); }
+    mapped_file &operator=(mapped_file &&other) noexcept
+    {
+        if (this != &other) {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~mapped_file() { close(); }
+
+    [[nodiscard]] auto data() const -> const char * { return bytes; }
+    [[nodiscard]] auto size() const -> size_t { return length; }
+    [[nodiscard]] auto view() const -> std::string_view { return { bytes, length }; }
+
+  private:
+#ifdef _WIN32
+    void open(const std::string &path)
+    {
+        file = CreateFileA(path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("could not open file " + path);
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            close();
+            throw std::runtime_error("could not stat file " + path);
+        }
+        length = static_cast<size_t>(size.QuadPart);
+        if (length == 0) return;
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            throw std::runtime_error("could not map file " + path);
+        }
+        bytes = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (bytes == nullptr) {
+            close();
+            throw std::runtime_error("could not map file " + path);
+        }
+    }
+
+    void close()
+    {
+        if (bytes != nullptr) UnmapViewOfFile(bytes);
+        if (mapping != nullptr) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        bytes = nullptr;
+        length = 0;
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+    }
+
+    void swap(mapped_file &other) noexcept
+    {
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+        std::swap(file, other.file);
+        std::swap(mapping, other.mapping);
+    }
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    void open(const std::string &path)
+    {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("could not open file " + path);
+
+        struct stat st = {};
+        if (::fstat(fd, &st) != 0) {
+            close();
+            throw std::runtime_error("could not stat file " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length == 0) return;
+
+        void *addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close();
+            throw std::runtime_error("could not map file " + path);
+        }
+        ::madvise(addr, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const char *>(addr);
+    }
+
+    void close()
+    {
+        if (bytes != nullptr) ::munmap(const_cast<char *>(bytes), length);
+        if (fd >= 0) ::close(fd);
+        bytes = nullptr;
+        length = 0;
+        fd = -1;
+    }
+
+    void swap(mapped_file &other) noexcept
+    {
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+        std::swap(fd, other.fd);
+    }
+
+    int fd = -1;
+#endif
+
+    const char *bytes = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * @brief Asks the operating system to start reading `path` into the page cache in the background.
+ *
+ * Only a hint: returns immediately, does nothing where there is no such hint or the file cannot be
+ * opened.
+ */
+inline void prefetch_file(const std::string &path)
+{
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * @brief Suffix for a temporary file name that no other call in any running process returns: the
+ * process id and a counter of the process
+ */
+inline auto unique_file_suffix() -> std::string
+{
+    static std::atomic<uint64_t> counter{ 0 };
+#ifdef _WIN32
+    const auto pid = static_cast<unsigned long>(::GetCurrentProcessId());
+#else
+    const auto pid = static_cast<unsigned long>(::getpid());
+#endif
+    return std::to_string(pid) + "." + std::to_string(counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+}// namespace tfs
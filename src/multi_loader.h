@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "tfs_dataframe.h"
+#include "thread_pool.h"
+
+namespace tfs {
+
+/**
+ * @brief One file for `load_files`, `options.columns` is its projection
+ */
+struct load_request
+{
+    std::string path;
+    read_options options = {};
+};
+
+/**
+ * @brief Options for `load_files`
+ */
+struct load_options
+{
+    /// number of files parsed at the same time, `0` for one per hardware thread
+    size_t threads = 0;
+    /// number of files ahead of the parsers whose reading is started in the background
+    size_t prefetch = 4;
+    /// fill `load_result::stats` for every file
+    bool stats = false;
+};
+
+/**
+ * @brief Outcome of loading one file, either the dataframe or the error message
+ */
+template<typename real = double> struct load_result
+{
+    std::string path;
+    dataframe<real> df;
+    std::string error;
+    /// only filled with `load_options::stats`
+    io_stats stats;
+
+    [[nodiscard]] auto ok() const -> bool { return error.empty(); }
+};
+
+/**
+ * @brief Loads many files concurrently.
+ *
+ * The files are parsed on one pool of `options.threads` workers, in request order. Every worker
+ * first asks the operating system to read ahead the file `options.prefetch` places further down the
+ * list, so disk reads overlap with parsing. Files are read through a memory mapping.
+ *
+ * The pool is already the parallelism, so the `threads` of a request only take effect when there
+ * are fewer files than workers, each file then gets its share of the spare workers on a pool of its
+ * own. Workers never wait on each other, so this cannot deadlock.
+ *
+ * A file that cannot be read does not stop the others, its result carries the error instead.
+ *
+ * @return one result per request, in request order
+ */
+template<typename real = double>
+auto load_files(const std::vector<load_request> &requests, const load_options &options = {})
+    -> std::vector<load_result<real>>
+{
+    const size_t n = requests.size();
+    std::vector<load_result<real>> results(n);
+    if (n == 0) return results;
+
+    const size_t workers = options.threads == 0 ? thread_pool::default_size() : options.threads;
+    const size_t threads = std::min(workers, n);
+    const size_t per_file = std::max<size_t>(1, workers / n);
+
+    for (size_t i = 0; i < std::min(options.prefetch, n); i++) prefetch_file(requests[i].path);
+
+    auto load = [&requests, &results, &options, n, per_file](size_t i) {
+        if (options.prefetch > 0 && i + options.prefetch < n) prefetch_file(requests[i + options.prefetch].path);
+
+        auto &result = results[i];
+        result.path = requests[i].path;
+        read_options file_options = requests[i].options;
+        file_options.memory_map = true;
+        file_options.threads = std::min(file_options.threads == 0 ? per_file : file_options.threads, per_file);
+        if (options.stats) file_options.stats = &result.stats;
+        try {
+            result.df = dataframe<real>(requests[i].path, file_options);
+        } catch (const std::exception &e) {
+            result.error = e.what();
+        }
+    };
+
+    if (threads <= 1) {
+        for (size_t i = 0; i < n; i++) load(i);
+        return results;
+    }
+
+    thread_pool pool(threads);
+    std::vector<std::future<void>> done;
+    done.reserve(n);
+    for (size_t i = 0; i < n; i++) done.push_back(pool.submit([&load, i] { load(i); }));
+    for (auto &f : done) f.get();
+    return results;
+}
+
+/**
+ * @brief Loads every file of `paths` with the same `read_options`
+ */
+template<typename real = double>
+auto load_files(const std::vector<std::string> &paths, const read_options &read = {}, const load_options &options = {})
+    -> std::vector<load_result<real>>
+{
+    std::vector<load_request> requests;
+    requests.reserve(paths.size());
+    for (auto &p : paths) requests.push_back({ p, read });
+    return load_files<real>(requests, options);
+}
+
+}// namespace tfs
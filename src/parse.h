@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <complex>
+#include <cstdlib>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace tfs {
+
+constexpr size_t NUMBER_BUFFER = 64;
+
+/**
+ * @brief Copies a numeric token into a NUL-terminated stack buffer for the C conversion functions.
+ *
+ * Anything longer than the buffer is not a number anyway and gets truncated.
+ */
+inline auto terminated(std::string_view s, char (&buffer)[NUMBER_BUFFER]) -> const char *
+{
+    const size_t n = std::min(s.size(), NUMBER_BUFFER - 1);
+    s.copy(buffer, n);
+    buffer[n] = '\0';
+    return buffer;
+}
+
+/**
+ * @brief Reference conversion through `strtod`/`strtof`, locale-aware and slow.
+ */
+template<typename real> auto strto_real(std::string_view s) -> real
+{
+    char buffer[NUMBER_BUFFER];
+    char *end;
+    if constexpr (std::is_same_v<real, float>) {
+        return strtof(terminated(s, buffer), &end);
+    } else {
+        return static_cast<real>(strtod(terminated(s, buffer), &end));
+    }
+}
+
+/**
+ * @brief Parses a floating point number from the character range `s` without allocating.
+ *
+ * Uses `std::from_chars`, which is locale independent and correctly rounded for `real` directly, so
+ * printing with shortest round-trip precision and parsing again is exact. Like `strtod` it accepts a
+ * leading `+`, stops at the first character that does not belong to the number and yields 0 if
+ * there is no number at all. Out of range values are handed to `strtod` to get its inf/denormal
+ * behaviour.
+ */
+template<typename real> auto parse_real(std::string_view s) -> real
+{
+#if defined(__cpp_lib_to_chars)
+    const char *first = s.data();
+    const char *last = s.data() + s.size();
+    if (first != last && *first == '+') ++first;
+
+    real value = 0;
+    const auto result = std::from_chars(first, last, value);
+    if (result.ec == std::errc()) return value;
+    if (result.ec == std::errc::result_out_of_range) return strto_real<real>(s);
+    return 0;
+#else
+    return strto_real<real>(s);
+#endif
+}
+
+/**
+ * @brief Parses a base 10 integer from the character range `s` without allocating.
+ *
+ * Same conventions as `parse_real`: optional leading `+`, trailing garbage is ignored, 0 if there
+ * is no number.
+ */
+template<typename integer = int> auto parse_int(std::string_view s) -> integer
+{
+    const char *first = s.data();
+    const char *last = s.data() + s.size();
+    if (first != last && *first == '+') ++first;
+
+    integer value = 0;
+    const auto result = std::from_chars(first, last, value, 10);
+    if (result.ec == std::errc()) return value;
+    return 0;
+}
+
+/**
+ * @brief Parses a `%b` value: `true`, `True`, `TRUE`, `T` and `1` (anything starting with `t`, `T` or
+ * `1`) are true, everything else is false.
+ */
+inline auto parse_bool(std::string_view s) -> bool
+{
+    return !s.empty() && (s.front() == 't' || s.front() == 'T' || s.front() == '1');
+}
+
+/**
+ * @brief Parses a complex number written as `re+imj` (Python style, `i` works too) from `s`.
+ *
+ * Surrounding parentheses are ignored, a missing real or imaginary part is 0, a bare `j` is 1j.
+ */
+template<typename real> auto parse_complex(std::string_view s) -> std::complex<real>
+{
+    if (!s.empty() && s.front() == '(') s.remove_prefix(1);
+    if (!s.empty() && s.back() == ')') s.remove_suffix(1);
+    if (s.empty()) return {};
+
+    const char unit = s.back();
+    if (unit != 'j' && unit != 'J' && unit != 'i' && unit != 'I') return { parse_real<real>(s), 0 };
+    s.remove_suffix(1);
+
+    // the imaginary part starts at the last sign that does not belong to an exponent
+    size_t split = 0;
+    for (size_t i = s.size(); i-- > 1;) {
+        if ((s[i] == '+' || s[i] == '-') && s[i - 1] != 'e' && s[i - 1] != 'E') {
+            split = i;
+            break;
+        }
+    }
+
+    const std::string_view im = s.substr(split);
+    real imag;
+    if (im.empty() || im == "+")
+        imag = 1;
+    else if (im == "-")
+        imag = -1;
+    else
+        imag = parse_real<real>(im);
+    return { split == 0 ? real(0) : parse_real<real>(s.substr(0, split)), imag };
+}
+
+}// namespace tfs
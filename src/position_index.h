@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "aggregate.h"
+#include "bit_column.h"
+#include "data.h"
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+namespace tfs {
+
+// ----------------------------------------------------------------------------------------
+// ---- Position index --------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// `position_index` answers "which row is at position s" on a sorted `%le` column such as `S`. The
+// values are stored in Eytzinger order, the implicit binary tree of a heap: node `k` has the
+// children `2k` and `2k + 1`. A search walks down from the root without branches, and the nodes of
+// the next levels are contiguous, so they are prefetched several levels ahead. Compared to
+// `std::lower_bound` on the column this removes the mispredicted branches and most cache misses
+// of the upper levels, which dominate for columns larger than the cache.
+
+namespace detail {
+
+    inline void prefetch(const void *p)
+    {
+#if defined(_MSC_VER)
+        _mm_prefetch(static_cast<const char *>(p), _MM_HINT_T0);
+#else
+        __builtin_prefetch(p);
+#endif
+    }
+
+}// namespace detail
+
+/**
+ * @brief Search tree over a non-decreasing `%le` column for point, range and interpolated lookups.
+ *
+ * The index copies the column, it stays valid when the dataframe changes but does not follow it.
+ */
+template<typename real = double> class position_index
+{
+  public:
+    position_index() = default;
+
+    /**
+     * @brief Indexes the `%le` column `column`. Throws if it is not sorted or contains NaN.
+     */
+    template<typename Alloc> explicit position_index(const data_vector<real, Alloc> &column)
+    {
+        const auto &values = column.as_real_vector();
+        positions.assign(values.begin(), values.end());
+        for (size_t i = 0; i < positions.size(); i++) {
+            if (std::isnan(positions[i]) || (i > 0 && positions[i] < positions[i - 1]))
+                throw std::runtime_error("column " + column.name + " is not sorted at row " + std::to_string(i));
+        }
+        keys.resize(positions.size() + 1);
+        rows.resize(positions.size() + 1);
+        fill(0, 1);
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return positions.size(); }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Point and range queries -----------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief First row whose position is at least `s`, `size()` if there is none. In a twiss
+     * table, where `S` is the end of each element, this is the element containing `s`.
+     */
+    [[nodiscard]] auto lower_bound(real s) const -> size_t { return search<false>(s); }
+
+    /**
+     * @brief First row whose position is greater than `s`, `size()` if there is none
+     */
+    [[nodiscard]] auto upper_bound(real s) const -> size_t { return search<true>(s); }
+
+    /**
+     * @brief Rows `[first, last)` whose positions lie in `[lo, hi]`
+     */
+    [[nodiscard]] auto range(real lo, real hi) const -> std::pair<size_t, size_t>
+    {
+        const size_t first = lower_bound(lo);
+        return { first, std::max(first, upper_bound(hi)) };
+    }
+
+    /**
+     * @brief `lower_bound` of each of `s`
+     */
+    [[nodiscard]] auto lower_bound(const std::vector<real> &s) const -> std::vector<size_t>
+    {
+        std::vector<size_t> result(s.size());
+        for (size_t i = 0; i < s.size(); i++) result[i] = search<false>(s[i]);
+        return result;
+    }
+
+    /**
+     * @brief `range` of each `[lo, hi]` interval of `intervals`
+     */
+    [[nodiscard]] auto range(const std::vector<std::pair<real, real>> &intervals) const
+        -> std::vector<std::pair<size_t, size_t>>
+    {
+        std::vector<std::pair<size_t, size_t>> result(intervals.size());
+        for (size_t i = 0; i < intervals.size(); i++) result[i] = range(intervals[i].first, intervals[i].second);
+        return result;
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Interpolation ---------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Value of the `%le` or `%d` column `column` at `s`, linearly interpolated between the
+     * rows around it. Positions outside the indexed range take the first or last value, NaN stays
+     * NaN. Where several rows share a position the first one is used.
+     */
+    template<typename Alloc> [[nodiscard]] auto interpolate(const data_vector<real, Alloc> &column, real s) const
+        -> real
+    {
+        check_column(column);
+        return detail::visit_numeric(column, [&](const auto *values, size_t) { return interpolate(values, s); });
+    }
+
+    /**
+     * @brief `interpolate` at each of `s`
+     */
+    template<typename Alloc>
+    [[nodiscard]] auto interpolate(const data_vector<real, Alloc> &column, const std::vector<real> &s) const
+        -> std::vector<real>
+    {
+        check_column(column);
+        std::vector<real> result(s.size());
+        detail::visit_numeric(column, [&](const auto *values, size_t) {
+            for (size_t i = 0; i < s.size(); i++) result[i] = interpolate(values, s[i]);
+        });
+        return result;
+    }
+
+  private:
+    /// Eytzinger slots per cache line, the descendants `log2(PREFETCH)` levels down are adjacent
+    static constexpr size_t PREFETCH = 64 / sizeof(real);
+
+    /**
+     * @brief Fills the subtree of node `k` with the sorted positions from `i` on, returns the next
+     * unused position
+     */
+    auto fill(size_t i, size_t k) -> size_t
+    {
+        if (k < keys.size()) {
+            i = fill(i, 2 * k);
+            keys[k] = positions[i];
+            rows[k] = i++;
+            i = fill(i, 2 * k + 1);
+        }
+        return i;
+    }
+
+    /**
+     * @brief First row whose position is `>= s`, or `> s` for `Upper`
+     */
+    template<bool Upper> auto search(real s) const -> size_t
+    {
+        const size_t n = positions.size();
+        const real *tree = keys.data();
+        size_t k = 1;
+        while (k <= n) {
+            if (PREFETCH * k < keys.size()) detail::prefetch(tree + PREFETCH * k);
+            k = 2 * k + static_cast<size_t>(Upper ? tree[k] <= s : tree[k] < s);
+        }
+        // the last left turn on the way down is the answer, undo the right turns after it
+        k >>= lowest_bit64(~static_cast<uint64_t>(k)) + 1;
+        return k == 0 ? n : rows[k];
+    }
+
+    template<typename T> auto interpolate(const T *values, real s) const -> real
+    {
+        if (std::isnan(s)) return s;
+        const size_t j = search<false>(s);
+        if (j == 0) return static_cast<real>(values[0]);
+        if (j == positions.size()) return static_cast<real>(values[j - 1]);
+        const real t = (s - positions[j - 1]) / (positions[j] - positions[j - 1]);
+        const real lo = static_cast<real>(values[j - 1]);
+        return lo + t * (static_cast<real>(values[j]) - lo);
+    }
+
+    template<typename Alloc> void check_column(const data_vector<real, Alloc> &column) const
+    {
+        if (positions.empty()) throw std::runtime_error("cannot interpolate on an empty index");
+        if (column.size() != positions.size()) {
+            throw std::runtime_error("column " + column.name + " has " + std::to_string(column.size())
+                                     + " rows, the index " + std::to_string(positions.size()));
+        }
+    }
+
+    /// the column in row order
+    std::vector<real> positions;
+    /// the column in Eytzinger order from slot 1 on, and the row of each slot
+    std::vector<real> keys;
+    std::vector<size_t> rows;
+};
+
+}// namespace tfs
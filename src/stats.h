@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+#if defined(TFS_CPP_COUNT_ALLOCATIONS)
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace tfs {
+
+// ----------------------------------------------------------------------------------------
+// ---- Instrumentation -------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// Reading and writing fill an `io_stats` when `read_options::stats` / `write_options::stats` point
+// to one. Without it the only cost is a null check per row.
+//
+// Allocations are counted by a replacement of the global `operator new`, which a program opts into
+// by defining `TFS_CPP_COUNT_ALLOCATIONS` in exactly one translation unit before including any
+// header of this library. The counters are process wide, allocations of unrelated threads during a
+// load are included. Without the replacement both allocation figures stay 0.
+
+/// one row in this many is parsed or formatted with per-column timing
+constexpr size_t STATS_SAMPLE_ROWS = 64;
+
+/**
+ * @brief Per-column figures of one read or write
+ */
+struct column_stats
+{
+    std::string name;
+    DataType type = DataType::LE;
+    /// time spent converting (reading) or formatting (writing) this column, extrapolated from the
+    /// sampled rows
+    double seconds = 0;
+    /// memory held by the column afterwards
+    size_t memory_bytes = 0;
+};
+
+/**
+ * @brief What one read or write of a file did and how long it took
+ */
+struct io_stats
+{
+    /// size of the file on disk, compressed files count with their compressed size
+    uint64_t bytes = 0;
+    size_t rows = 0;
+    /// loaded (or written) cells, `rows` times the number of columns
+    size_t cells = 0;
+    /// properties and column header, including the column selection
+    double header_seconds = 0;
+    /// data rows, including the row index
+    double body_seconds = 0;
+    /// heap allocations and their bytes, see `TFS_CPP_COUNT_ALLOCATIONS`
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    /// in column order of the dataframe
+    std::vector<column_stats> columns;
+
+    [[nodiscard]] auto seconds() const -> double { return header_seconds + body_seconds; }
+    [[nodiscard]] auto rows_per_second() const -> double { return seconds() > 0 ? rows / seconds() : 0; }
+    [[nodiscard]] auto cells_per_second() const -> double { return seconds() > 0 ? cells / seconds() : 0; }
+};
+
+namespace detail {
+
+    using stats_clock = std::chrono::steady_clock;
+
+    inline auto seconds_since(stats_clock::time_point start) -> double
+    {
+        return std::chrono::duration<double>(stats_clock::now() - start).count();
+    }
+
+    inline std::atomic<size_t> allocation_count{ 0 };
+    inline std::atomic<size_t> allocation_bytes{ 0 };
+
+    /**
+     * @brief Allocation counters at construction, `record` stores the difference since then
+     */
+    struct allocation_snapshot
+    {
+        size_t count = allocation_count.load(std::memory_order_relaxed);
+        size_t bytes = allocation_bytes.load(std::memory_order_relaxed);
+
+        void record(io_stats &stats) const
+        {
+            stats.allocations = allocation_count.load(std::memory_order_relaxed) - count;
+            stats.allocated_bytes = allocation_bytes.load(std::memory_order_relaxed) - bytes;
+        }
+    };
+
+    /**
+     * @brief Per-column time of the sampled rows of one parse or format pass. Passes over chunks
+     * of the same file are combined with `merge`.
+     */
+    struct stats_recorder
+    {
+        std::vector<double> seconds;
+        size_t rows = 0;
+        size_t sampled = 0;
+        /// end of the header section
+        stats_clock::time_point header_end = stats_clock::now();
+
+        /**
+         * @brief Counts a row, true if it is to be timed
+         */
+        auto sample() -> bool
+        {
+            const bool timed = rows++ % STATS_SAMPLE_ROWS == 0;
+            sampled += timed;
+            return timed;
+        }
+
+        void add(size_t column, stats_clock::time_point start)
+        {
+            if (seconds.size() <= column) seconds.resize(column + 1);
+            seconds[column] += seconds_since(start);
+        }
+
+        void merge(const stats_recorder &other)
+        {
+            if (seconds.size() < other.seconds.size()) seconds.resize(other.seconds.size());
+            for (size_t i = 0; i < other.seconds.size(); i++) seconds[i] += other.seconds[i];
+            rows += other.rows;
+            sampled += other.sampled;
+        }
+
+        /**
+         * @brief Time of `column` over all rows, extrapolated from the sampled ones
+         */
+        [[nodiscard]] auto estimate(size_t column) const -> double
+        {
+            if (sampled == 0 || column >= seconds.size()) return 0;
+            return seconds[column] * static_cast<double>(rows) / static_cast<double>(sampled);
+        }
+    };
+
+}// namespace detail
+
+}// namespace tfs
+
+#if defined(TFS_CPP_COUNT_ALLOCATIONS)
+// the array and nothrow forms forward to these by default
+
+void *operator new(std::size_t n)
+{
+    tfs::detail::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    tfs::detail::allocation_bytes.fetch_add(n, std::memory_order_relaxed);
+    if (void *p = std::malloc(n == 0 ? 1 : n)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+#endif
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tfs {
+
+enum class string_encoding {
+    plain,// every value stored in the arena
+    dictionary,// distinct values stored once, rows hold codes
+    automatic,// dictionary while the column looks low-cardinality, plain otherwise
+};
+
+/// number of rows after which an `automatic` column decides whether to stay dictionary encoded
+constexpr size_t DICTIONARY_PROBE_ROWS = 4096;
+
+/**
+ * @brief String column with contiguous storage.
+ *
+ * All characters live in one arena, a value is addressed by its offset into the arena. In
+ * dictionary mode each distinct value is stored only once and rows hold a 32 bit code, distinct
+ * values are found through an open-addressing hash table over the codes. Values are handed out as
+ * `std::string_view`s into the arena, which stay valid until the column is modified.
+ */
+class string_column
+{
+  public:
+    explicit string_column(string_encoding encoding = string_encoding::automatic)
+        : encoding(encoding == string_encoding::plain ? string_encoding::plain : string_encoding::dictionary),
+          automatic(encoding == string_encoding::automatic)
+    {}
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Insertion -------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    void push_back(std::string_view s)
+    {
+        if (encoding == string_encoding::plain) {
+            store(s);
+            return;
+        }
+
+        codes.push_back(intern(s));
+        if (automatic && codes.size() == DICTIONARY_PROBE_ROWS && cardinality() > DICTIONARY_PROBE_ROWS / 4) {
+            to_plain();
+        }
+    }
+
+    /**
+     * @brief Moves all values of `other` to the end of this column
+     */
+    void append(string_column &&other)
+    {
+        if (encoding == string_encoding::plain && other.encoding == string_encoding::plain) {
+            const uint64_t shift = arena.size();
+            arena.append(other.arena);
+            offsets.reserve(offsets.size() + other.size());
+            for (size_t i = 1; i < other.offsets.size(); i++) offsets.push_back(other.offsets[i] + shift);
+            return;
+        }
+        reserve(size() + other.size());
+        for (size_t i = 0; i < other.size(); i++) push_back(other[i]);
+    }
+
+    void reserve(size_t n)
+    {
+        if (encoding == string_encoding::plain)
+            offsets.reserve(n + 1);
+        else
+            codes.reserve(n);
+    }
+
+    /**
+     * @brief Removes all values, keeping the allocated storage for reuse
+     */
+    void clear()
+    {
+        arena.clear();
+        offsets.assign(1, 0);
+        codes.clear();
+        std::fill(slots.begin(), slots.end(), EMPTY);
+        if (automatic) encoding = string_encoding::dictionary;
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Extraction ------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    [[nodiscard]] auto operator[](size_t i) const -> std::string_view
+    {
+        return value(encoding == string_encoding::plain ? i : codes[i]);
+    }
+
+    [[nodiscard]] auto size() const -> size_t
+    {
+        return encoding == string_encoding::plain ? offsets.size() - 1 : codes.size();
+    }
+
+    [[nodiscard]] auto to_vector() const -> std::vector<std::string>
+    {
+        std::vector<std::string> v;
+        v.reserve(size());
+        for (size_t i = 0; i < size(); i++) v.emplace_back((*this)[i]);
+        return v;
+    }
+
+    // ---- dictionary access -----------------------------------------------------------------
+
+    [[nodiscard]] auto is_dictionary() const -> bool { return encoding == string_encoding::dictionary; }
+
+    /**
+     * @brief Number of distinct values in dictionary mode
+     */
+    [[nodiscard]] auto cardinality() const -> size_t { return is_dictionary() ? offsets.size() - 1 : size(); }
+
+    /**
+     * @brief Dictionary code of row `i`, only valid in dictionary mode
+     */
+    [[nodiscard]] auto code(size_t i) const -> uint32_t { return codes[i]; }
+
+    /**
+     * @brief Value of dictionary entry `c`, only valid in dictionary mode
+     */
+    [[nodiscard]] auto dictionary_value(uint32_t c) const -> std::string_view { return value(c); }
+
+    /**
+     * @brief Bytes allocated by this column
+     */
+    [[nodiscard]] auto memory_usage() const -> size_t
+    {
+        return arena.capacity() + offsets.capacity() * sizeof(uint64_t) + codes.capacity() * sizeof(uint32_t)
+               + slots.capacity() * sizeof(uint32_t);
+    }
+
+  private:
+    static constexpr uint32_t EMPTY = static_cast<uint32_t>(-1);
+
+    [[nodiscard]] auto value(size_t entry) const -> std::string_view
+    {
+        return { arena.data() + offsets[entry], static_cast<size_t>(offsets[entry + 1] - offsets[entry]) };
+    }
+
+    auto store(std::string_view s) -> uint32_t
+    {
+        arena.append(s);
+        offsets.push_back(arena.size());
+        return static_cast<uint32_t>(offsets.size() - 2);
+    }
+
+    /**
+     * @brief Returns the dictionary code of `s`, adding it if necessary
+     */
+    auto intern(std::string_view s) -> uint32_t
+    {
+        if ((cardinality() + 1) * 2 > slots.size()) rehash(slots.empty() ? 64 : slots.size() * 2);
+
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = std::hash<std::string_view>{}(s) & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot] == EMPTY) {
+                if (cardinality() >= EMPTY) throw std::runtime_error("too many distinct strings in column");
+                slots[slot] = store(s);
+                return slots[slot];
+            }
+            if (value(slots[slot]) == s) return slots[slot];
+        }
+    }
+
+    void rehash(size_t n)
+    {
+        slots.assign(n, EMPTY);
+        const size_t mask = n - 1;
+        for (uint32_t c = 0; c < cardinality(); c++) {
+            size_t slot = std::hash<std::string_view>{}(value(c)) & mask;
+            while (slots[slot] != EMPTY) slot = (slot + 1) & mask;
+            slots[slot] = c;
+        }
+    }
+
+    void to_plain()
+    {
+        std::string plain_arena;
+        std::vector<uint64_t> plain_offsets{ 0 };
+        plain_offsets.reserve(codes.capacity() + 1);
+        for (auto c : codes) {
+            plain_arena.append(value(c));
+            plain_offsets.push_back(plain_arena.size());
+        }
+        arena = std::move(plain_arena);
+        offsets = std::move(plain_offsets);
+        codes = std::vector<uint32_t>();
+        slots = std::vector<uint32_t>();
+        encoding = string_encoding::plain;
+    }
+
+    string_encoding encoding;
+    bool automatic;
+    std::string arena;
+    std::vector<uint64_t> offsets{ 0 };
+    std::vector<uint32_t> codes;
+    std::vector<uint32_t> slots;
+};
+
+}// namespace tfs
@@ -1,32 +1,172 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include "aggregate.h"
+#include "binary.h"
+#include "compression.h"
 #include "data.h"
+#include "expression.h"
+#include "filter.h"
+#include "hash_index.h"
+#include "mapped_file.h"
+#include "stats.h"
+#include "thread_pool.h"
 
 namespace tfs {
-template<typename real = double> class dataframe
+
+/**
+ * @brief Options for reading a dataframe from a file
+ */
+struct read_options
+{
+    /// name of the string column to build the row index on, empty for no index
+    std::string index;
+    /// parse directly from a memory mapping of the file instead of going through `std::ifstream`
+    bool memory_map = false;
+    /// number of threads parsing the data section, `0` for one per hardware thread. Parallel parsing
+    /// works on the memory mapped file, so anything but `1` implies `memory_map`.
+    size_t threads = 1;
+    /// names of the columns to load, empty for all. The `index` column is always loaded.
+    std::vector<std::string> columns = {};
+    /// use the `<path>.bin` sidecar written by `save_binary` if it is newer than the text file,
+    /// otherwise parse the text file and (re)create the sidecar
+    bool binary_cache = false;
+    /// store `%s` columns as contiguous `string_column`s, dictionary encoded while they have few
+    /// distinct values
+    bool compact_strings = false;
+    /// filled with what the read did and how long it took, see `stats.h`
+    io_stats *stats = nullptr;
+};
+
+/// smallest chunk of the data section (in bytes) that is worth handing to a separate thread
+constexpr size_t PARALLEL_MIN_CHUNK = 1 << 16;
+
+/**
+ * @brief Options for writing a dataframe to a file
+ */
+struct write_options
+{
+    /// number of threads formatting rows, `0` for one per hardware thread
+    size_t threads = 1;
+    /// compression of the output file, by default chosen from its name (`.gz`, `.zst`)
+    compression compress = compression::automatic;
+    /// filled with what the write did and how long it took, see `stats.h`
+    io_stats *stats = nullptr;
+};
+
+/// number of rows formatted into one output buffer before it is written out
+constexpr size_t WRITE_BLOCK_ROWS = 1 << 14;
+
+/// what `dataframe::refresh` did
+enum class refresh_status {
+    unchanged,// nothing new in the file
+    appended,// new complete rows were parsed and appended
+    reloaded,// the file was truncated or rewritten and read again from scratch
+};
+
+/// number of bytes before the end of the parsed data that `dataframe::refresh` compares to detect a
+/// rewritten file
+constexpr size_t REFRESH_TAIL_BYTES = 256;
+
+enum class join_type {
+    inner,// rows whose key is in both dataframes
+    left,// every row of the left dataframe, missing values where the key is not in the right one
+};
+
+/**
+ * @brief Options for joining two dataframes
+ */
+struct join_options
+{
+    join_type how = join_type::inner;
+    /// appended to the names of non-key columns that exist in both dataframes
+    std::string left_suffix = "_x";
+    std::string right_suffix = "_y";
+    /// number of threads gathering the output columns, `0` for one per hardware thread
+    size_t threads = 1;
+};
+
+template<typename real> class batch_reader;
+template<typename real, typename Alloc> class dataframe_view;
+
+/**
+ * @brief Columns of a TFS file with its properties.
+ *
+ * `Alloc` is the allocator of the column payloads, see `data_vector`. With
+ * `tfs::pmr::dataframe` a whole load lives in one `std::pmr::memory_resource`, e.g. a
+ * `std::pmr::monotonic_buffer_resource` that is released in one go instead of freeing every string
+ * cell. Parsing on several threads only allocates from it on the calling thread, but `select` and
+ * `join` with `threads` other than 1 allocate concurrently and need a thread safe resource.
+ */
+template<typename real = double, typename Alloc = std::allocator<char>> class dataframe
 {
   public:
+    using allocator_type = Alloc;
+    using column_type = data_vector<real, Alloc>;
+
     // ----------------------------------------------------------------------------------------
     // ---- Init ------------------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
     dataframe() = default;
 
-    explicit dataframe(const std::string &path, const std::string &index = "");
+    /**
+     * @brief Empty dataframe whose columns allocate through `alloc`
+     */
+    explicit dataframe(const Alloc &alloc) : allocator{ alloc } {}
+
+    explicit dataframe(const std::string &path, const std::string &index = "")
+        : dataframe(path, read_options{ index })
+    {}
+
+    /**
+     * @brief Reads the dataframe from `path`.
+     *
+     * With `options.memory_map` the file is mapped and tokenized in place, only cell values are
+     * copied out of it. With `options.threads` the data section is split into chunks at line
+     * boundaries, which are parsed concurrently and concatenated in order. The resulting dataframe
+     * is the same in all modes.
+     *
+     * With `options.columns` only the listed columns are converted and stored, all other fields of a
+     * row are skipped over. Throws if one of them is not in the file.
+     *
+     * With `options.binary_cache` an up to date binary sidecar replaces the text parsing entirely.
+     *
+     * Gzip and zstd compressed files are recognized by their content and decompressed on a
+     * background thread while the parser consumes the decompressed blocks, `memory_map` and
+     * `threads` do not apply to them.
+     *
+     * The columns allocate through `alloc`.
+     */
+    dataframe(const std::string &path, const read_options &options, const Alloc &alloc = Alloc());
 
     // ----------------------------------------------------------------------------------------
     // ---- Columns ---------------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
-    data_vector<real> &get_column(const std::string &name);
-    data_vector<real> &get_column(size_t index) { return columns[index]; }
+    /**
+     * @brief Returns the column `name`, looked up in constant time. Throws if there is none.
+     */
+    column_type &get_column(const std::string &name);
+    const column_type &get_column(const std::string &name) const;
+    column_type &get_column(size_t index) { return columns[index]; }
+    const column_type &get_column(size_t index) const { return columns[index]; }
+
+    [[nodiscard]] auto has_column(const std::string &name) const -> bool { return column_index.contains(name); }
 
     /**
      * @brief Reserves space for n columns
@@ -38,9 +178,12 @@ template<typename real = double> class dataframe
      */
     void add_column(std::vector<real> &&vec, const std::string &name)
     {
-        column_headers[name] = columns.size();
-        data_vector<real> v(DataType::LE, name);
-        v.payload.double_vector = std::move(vec);
+        register_column(name);
+        column_type v(DataType::LE, name, allocator.alloc);
+        if constexpr (std::is_same_v<typename column_type::real_vector_type, std::vector<real>>)
+            v.payload.double_vector = std::move(vec);
+        else
+            v.payload.double_vector.assign(vec.begin(), vec.end());
         columns.push_back(std::move(v));
     }
 
@@ -50,9 +193,9 @@ template<typename real = double> class dataframe
      * @param vec
      * @param name
      */
-    void add_column(const data_vector<real> &vec, const std::string &name)
+    void add_column(const column_type &vec, const std::string &name)
     {
-        column_headers[name] = columns.size();
+        register_column(name);
         columns.push_back(vec);
     }
 
@@ -64,9 +207,9 @@ template<typename real = double> class dataframe
      */
     void add_column(const std::vector<double> &vec, const std::string &name)
     {
-        column_headers[name] = columns.size();
-        data_vector<real> v(DataType::LE, name);
-        v.payload.double_vector = vec;
+        register_column(name);
+        column_type v(DataType::LE, name, allocator.alloc);
+        v.payload.double_vector.assign(vec.begin(), vec.end());
         columns.push_back(std::move(v));
     }
 
@@ -78,9 +221,9 @@ template<typename real = double> class dataframe
      */
     void add_column(const std::vector<std::string> &vec, const std::string &name)
     {
-        column_headers[name] = columns.size();
-        data_vector<real> v(DataType::S, name);
-        v.payload.string_vector = vec;
+        register_column(name);
+        column_type v(DataType::S, name, allocator.alloc);
+        v.payload.string_vector.assign(vec.begin(), vec.end());
         columns.push_back(std::move(v));
     }
 
@@ -92,33 +235,114 @@ template<typename real = double> class dataframe
      */
     void add_column(const std::vector<int> &vec, const std::string &name)
     {
-        column_headers[name] = columns.size();
-        data_vector<real> v(DataType::D, name);
-        v.payload.int_vector = vec;
+        register_column(name);
+        column_type v(DataType::D, name, allocator.alloc);
+        v.payload.int_vector.assign(vec.begin(), vec.end());
         columns.push_back(std::move(v));
     }
 
+    /**
+     * @brief Adds a complex column to the dataframe, stored as split real and imaginary parts.
+     *
+     * @param vec
+     * @param name
+     */
+    void add_column(const std::vector<std::complex<real>> &vec, const std::string &name)
+    {
+        register_column(name);
+        column_type v(DataType::C, name);
+        v.payload.complex_vector.reserve(vec.size());
+        for (auto &c : vec) v.payload.complex_vector.push_back(c);
+        columns.push_back(std::move(v));
+    }
+
+    /**
+     * @brief Computes the expression `e` (see `expression.h`) into a new `%le` column, in one pass
+     * over the rows. With `threads` other than 1 row ranges are computed concurrently.
+     */
+    template<typename E> void add_column(const expression<E> &e, const std::string &name, size_t threads = 1)
+    {
+        if (e.self().size() == BROADCAST) throw std::runtime_error("an expression needs at least one column");
+        column_type v(DataType::LE, name, allocator.alloc);
+        v.payload.double_vector.resize(e.self().size());
+        evaluate_into(e, v.payload.double_vector.data(), threads);
+        register_column(name);
+        columns.push_back(std::move(v));
+    }
+
+    /**
+     * @brief The `%le` column `name` as operand of a column expression
+     */
+    [[nodiscard]] auto expr(const std::string &name) const -> column_expr<real>
+    {
+        const auto &v = get_column(name).as_real_vector();
+        return column_expr<real>(v.data(), v.size());
+    }
+
+    /**
+     * @brief The `%d` column `name` as operand of a column expression
+     */
+    [[nodiscard]] auto int_expr(const std::string &name) const -> column_expr<int>
+    {
+        const auto &v = get_column(name).as_int_vector();
+        return column_expr<int>(v.data(), v.size());
+    }
+
     /**
      * @brief Adds a column of arbitrary type to the dataframe
      *
      * @param name
      * @param t
-     * @return data_vector<real>&
+     * @return column_type&
      */
-    data_vector<real> &add_column(const std::string &name, DataType t)
+    column_type &add_column(const std::string &name, DataType t)
     {
-        column_headers[name] = columns.size();
-        columns.emplace_back(t, name);
+        register_column(name);
+        columns.emplace_back(t, name, allocator.alloc);
 
         return columns.back();
     }
 
+    /**
+     * @brief Catches up with a file that is still being appended to.
+     *
+     * A dataframe read from a path remembers the header it validated and the byte offset just past
+     * the last row it parsed. `refresh` parses only the complete lines appended since then and
+     * extends the columns (and the row index) in place, an incomplete last line is left for the
+     * next call. If the file shrank, its header or the bytes before the remembered offset changed,
+     * or the last row parsed was incomplete, the file is read again from scratch with the original
+     * options. A dataframe loaded from a binary sidecar is always reloaded from the text file.
+     */
+    auto refresh() -> refresh_status;
+
     /**
      * @brief Writes the dataframe to a file int tfs format.
      *
+     * Rows are formatted block-wise into a memory buffer (numbers with `std::to_chars` in shortest
+     * round-trip precision) and written out in one go per block. With `options.threads` the blocks
+     * are formatted concurrently and written in order. Compressed output (`options.compress`) is
+     * compressed on a background thread while the next blocks are formatted.
+     *
      * @param fname
      */
-    void to_file(const std::string &filename);
+    void to_file(const std::string &filename, const write_options &options = {}) const;
+
+    /**
+     * @brief Writes the dataframe in the binary columnar layout described in binary.h.
+     *
+     * The file is only valid for the same `real` type and byte order.
+     */
+    void save_binary(const std::string &filename) const;
+
+    /**
+     * @brief Reads a dataframe written by `save_binary`, without any text parsing.
+     *
+     * The file is memory mapped and each column is copied out of it in one go. `options.columns`
+     * and `options.index` apply as for the text reader, columns that are not requested are
+     * skipped over.
+     */
+    static auto load_binary(const std::string &filename, const read_options &options = {}, const Alloc &alloc = Alloc())
+        -> dataframe;
 
     // ----------------------------------------------------------------------------------------
     // ---- TFS Properties --------------------------------------------------------------------
@@ -126,6 +350,8 @@ template<typename real = double> class dataframe
 
     data_value<real> &get_property(const std::string &key) { return properties[key]; }
 
+    [[nodiscard]] auto get_properties() const -> const std::map<std::string, data_value<real>> & { return properties; }
+
     template<typename T> void insert_property(std::string const &key, T const &value)
     {
         properties.insert(std::make_pair(key, data_value<real>{ value }));
@@ -144,13 +370,170 @@ template<typename real = double> class dataframe
         return columns[(*column_headers.begin()).second].size();
     }
 
+    /**
+     * @brief Names of the columns in the order they are written
+     */
+    [[nodiscard]] auto column_names() const -> std::vector<std::string>
+    {
+        std::vector<std::string> names;
+        names.reserve(column_headers.size());
+        for (auto &c : column_headers) names.push_back(c.first);
+        return names;
+    }
+
+    /**
+     * @brief Bytes allocated by the columns of the dataframe
+     */
+    [[nodiscard]] auto memory_usage() const -> size_t
+    {
+        size_t bytes = 0;
+        for (auto &c : columns) bytes += c.memory_usage();
+        return bytes;
+    }
+
     /**
      * @brief Get the index of the given key
      *
+     * Throws if `key` is not in the index.
+     *
      * @param key
      * @return size_t
      */
-    size_t get_index(const std::string &key) { return idx[key]; }
+    size_t get_index(const std::string &key) const
+    {
+        const size_t i = idx.find(key);
+        if (i == hash_index::npos) throw std::runtime_error("key " + key + " not found in index");
+        return i;
+    }
+
+    /**
+     * @brief Row of the given key, or `hash_index::npos` if it is not in the index
+     */
+    [[nodiscard]] auto find_index(std::string_view key) const -> size_t { return idx.find(key); }
+
+    /**
+     * @brief (Re)builds the row index on the string column `column`.
+     *
+     * The first row of every key is indexed, keys that occur more than once are reported.
+     *
+     * @return the duplicate keys, once per extra occurrence
+     */
+    auto set_index(const std::string &column) -> const std::vector<std::string> &;
+
+    /**
+     * @brief Duplicate keys found when the current row index was built
+     */
+    [[nodiscard]] auto index_duplicates() const -> const std::vector<std::string> & { return idx.duplicates(); }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Row selection ---------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Rows where `column op value`, see filter.h for the other kernels. Combine the masks
+     * with `&`, `|` and `~` and pass them to `select`.
+     */
+    [[nodiscard]] auto where(const std::string &column, compare_op op, double value) const -> bit_column
+    {
+        return compare(get_column(column), op, value);
+    }
+
+    /**
+     * @brief Rows where `lo <= column <= hi`
+     */
+    [[nodiscard]] auto where_between(const std::string &column, double lo, double hi) const -> bit_column
+    {
+        return between(get_column(column), lo, hi);
+    }
+
+    /**
+     * @brief Rows where the string `column` starts with `prefix`
+     */
+    [[nodiscard]] auto where_prefix(const std::string &column, std::string_view prefix) const -> bit_column
+    {
+        return starts_with(get_column(column), prefix);
+    }
+
+    /**
+     * @brief Rows where the string `column` contains a match of `pattern`
+     */
+    [[nodiscard]] auto where_match(const std::string &column, const std::string &pattern) const -> bit_column
+    {
+        return matches(get_column(column), std::regex(pattern));
+    }
+
+    /**
+     * @brief New dataframe holding the rows set in `mask`, which needs one bit per row.
+     *
+     * Every column is gathered straight from the words of the mask, no list of rows is built. With
+     * `threads` other than 1 the columns are gathered concurrently (`0` for one thread per hardware
+     * thread). Properties are copied, the row index is not carried over (call `set_index` on the
+     * result).
+     */
+    [[nodiscard]] auto select(const bit_column &mask, size_t threads = 1) const -> dataframe;
+
+    /**
+     * @brief New dataframe holding the given rows, in the given order
+     */
+    [[nodiscard]] auto select(const std::vector<size_t> &rows, size_t threads = 1) const -> dataframe;
+
+    /**
+     * @brief Joins `right` to this dataframe on the string column `key`, which both need.
+     *
+     * The hash table is built over the keys of the smaller dataframe and probed with the other one.
+     * The result follows the row order of this dataframe, a key that occurs several times on both
+     * sides yields every pair. Each output column is gathered with the matched rows in one pass.
+     * Properties are taken from this dataframe, the row index is not carried over.
+     */
+    [[nodiscard]] auto join(const dataframe &right, const std::string &key, const join_options &options = {}) const
+        -> dataframe;
+
+    /**
+     * @brief Count, sum, mean, min, max, standard deviation and RMS of a `%le` or `%d` column, see
+     * `aggregate.h`. With `threads` other than 1 long columns are reduced concurrently.
+     */
+    [[nodiscard]] auto summarize(const std::string &column, size_t threads = 1) const -> summary
+    {
+        return tfs::summarize(get_column(column), threads);
+    }
+
+    /**
+     * @brief Statistics of several columns, reduced on one shared pool of `threads` workers
+     */
+    [[nodiscard]] auto summarize(const std::vector<std::string> &names, size_t threads = 1) const
+        -> std::vector<summary>
+    {
+        return tfs::summarize(column_pointers(names), threads);
+    }
+
+    /// a braced list of two names would otherwise also match the iterator pair constructor of `std::string`
+    [[nodiscard]] auto summarize(std::initializer_list<std::string> names, size_t threads = 1) const
+        -> std::vector<summary>
+    {
+        return summarize(std::vector<std::string>(names), threads);
+    }
+
+    /**
+     * @brief Statistics of `names` per distinct value of the `%s` or `%d` column `key`
+     */
+    [[nodiscard]] auto summarize_by(const std::string &key, const std::vector<std::string> &names, size_t threads = 1)
+        const -> grouped_summary
+    {
+        return tfs::summarize_by(get_column(key), column_pointers(names), threads);
+    }
+
+    /**
+     * @brief Statistics of `names` per group of the string column `key`, `key_of` maps a key to its
+     * group, e.g. `[](std::string_view name) { return name.substr(0, 3); }`
+     */
+    template<typename KeyOf>
+    [[nodiscard]] auto summarize_by(const std::string &key,
+        KeyOf &&key_of,
+        const std::vector<std::string> &names,
+        size_t threads = 1) const -> grouped_summary
+    {
+        return tfs::summarize_by(get_column(key), std::forward<KeyOf>(key_of), column_pointers(names), threads);
+    }
 
     /**
      * @brief Returns a formatted description of the dataframe
@@ -165,37 +548,115 @@ template<typename real = double> class dataframe
     // ----------------------------------------------------------------------------------------
 
   private:
-    void read_property(const std::string &line);
-    void read_column_headers(const std::string &line);
-    void read_column_types(const std::string &line);
-    void read_line(const std::string &line);
+    friend class batch_reader<real>;
+    friend class dataframe_view<real, Alloc>;
+
+    bool read_cached(const std::string &path, const read_options &options);
+    void read_stream(std::istream &stream, const read_options &options, detail::stats_recorder *recorder);
+    void read_source(byte_source &in, const read_options &options, detail::stats_recorder *recorder);
+    void read_appended(std::string_view appended);
+    void remember_tail(std::string_view parsed);
+    void read_header_stream(std::istream &stream, const read_options &options);
+    void read_buffer(std::string_view buffer, const read_options &options, detail::stats_recorder *recorder);
+    void read_body_parallel(std::string_view body, size_t threads, detail::stats_recorder *recorder);
+    auto read_chunk(std::string_view chunk, detail::stats_recorder *recorder) const -> std::vector<column_type>;
+    void read_header_line(std::string_view line, std::vector<std::string_view> &tokens);
+    void read_property(std::string_view line, std::vector<std::string_view> &tokens);
+    void read_column_headers(std::string_view line, std::vector<std::string_view> &tokens);
+    void read_column_types(std::string_view line, std::vector<std::string_view> &tokens);
+    void read_line(std::string_view line, std::vector<column_type> &dest) const;
+    void read_line(std::string_view line, std::vector<column_type> &dest, detail::stats_recorder *recorder) const;
     void check_ini();
+    void select_columns(const read_options &options);
+    void format_header(std::string &out,
+        const std::vector<std::string> &names,
+        const std::vector<const column_type *> &order) const;
+    void write_rows(const std::string &filename,
+        const write_options &options,
+        const std::vector<std::string> &names,
+        const std::vector<const column_type *> &order,
+        size_t begin,
+        size_t end) const;
+    void format_rows(const std::vector<const column_type *> &order,
+        size_t begin,
+        size_t end,
+        std::string &out,
+        detail::stats_recorder *recorder) const;
+    void record_stats(io_stats &stats,
+        uint64_t bytes,
+        size_t rows,
+        const std::vector<const column_type *> &order,
+        detail::stats_clock::time_point start,
+        const detail::allocation_snapshot &allocations,
+        const detail::stats_recorder &recorder) const;
+    void build_index(const std::string &index);
+    template<typename F>
+    static auto gather_columns(size_t n, F &&gather_one, size_t threads) -> std::vector<column_type>;
+    void register_column(const std::string &name);
+    auto column_pointers(const std::vector<std::string> &names) const -> std::vector<const column_type *>;
+    void index_columns();
 
     // ----------------------------------------------------------------------------------------
     // ---- Private Fields --------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
 
-    std::vector<data_vector<real>> columns;
+    std::vector<column_type> columns;
     std::map<std::string, size_t> column_headers;
     std::map<std::string, data_value<real>> properties;
-    std::map<std::string, size_t> idx;
+    hash_index column_index;
+    hash_index idx;
     bool ini_complete = false;
+
+    /// name of the column `idx` is built on
+    std::string index_column;
+
+    /// allocator of new columns, assignment keeps it like containers keep theirs
+    struct column_allocator
+    {
+        Alloc alloc;
+
+        column_allocator() = default;
+        column_allocator(const Alloc &alloc) : alloc(alloc) {}
+        column_allocator(const column_allocator &) = default;
+        auto operator=(const column_allocator &) -> column_allocator & { return *this; }
+    } allocator;
+
+    /// what was read from which file, for `refresh`
+    struct source_state
+    {
+        std::string path;
+        read_options options;
+        /// header section as validated when the file was read
+        std::string header;
+        /// offset just past the last parsed line
+        uint64_t parsed_end = 0;
+        /// the last `REFRESH_TAIL_BYTES` bytes before `parsed_end`
+        std::string tail;
+        /// the last parsed line was terminated by a newline
+        bool complete = false;
+        /// `header` and `parsed_end` describe the file, false e.g. for binary sidecars
+        bool valid = false;
+    } source;
+
+    /// target column of each field of a data row, `SKIP` for fields that are not loaded
+    std::vector<size_t> projection;
+    static constexpr size_t SKIP = static_cast<size_t>(-1);
 };
 
 
 template<class ContainerT>
-void tokenize(const std::string &str, ContainerT &tokens, const std::string &delimiters = " ", bool trimEmpty = false)
+void tokenize(std::string_view str, ContainerT &tokens, std::string_view delimiters = " ", bool trimEmpty = false)
 {
-    std::string::size_type pos = 0;
-    std::string::size_type lastPos = str.find_first_not_of(delimiters, 0);
-    std::string::size_type length = str.length();
+    std::string_view::size_type pos = 0;
+    std::string_view::size_type lastPos = str.find_first_not_of(delimiters, 0);
+    std::string_view::size_type length = str.length();
 
     using value_type = typename ContainerT::value_type;
     using size_type = typename ContainerT::size_type;
 
     while (lastPos < length + 1) {
         pos = str.find_first_of(delimiters, lastPos);
-        if (pos == std::string::npos) { pos = length; }
+        if (pos == std::string_view::npos) { pos = length; }
 
         if (pos != lastPos || !trimEmpty) {
             tokens.push_back(value_type(str.data() + lastPos, (size_type)pos - lastPos));
@@ -205,118 +666,1096 @@ void tokenize(const std::string &str, ContainerT &tokens, const std::string &del
     }
 }
 
+/**
+ * @brief Extracts the next whitespace separated token of `line` starting at `pos`.
+ *
+ * Splits the same way as `tokenize(line, tokens)`, without storing the tokens anywhere.
+ *
+ * @return false if there are no more tokens
+ */
+inline bool next_token(std::string_view line, size_t &pos, std::string_view &token)
+{
+    const size_t n = line.size();
+    while (pos < n && line[pos] == ' ') ++pos;
+    if (pos >= n) return false;
+    const size_t begin = pos;
+    while (pos < n && line[pos] != ' ') ++pos;
+    token = line.substr(begin, pos - begin);
+    return true;
+}
+
+/**
+ * @brief Extracts the next line of `buffer` starting at `pos`, like `std::getline` does for streams.
+ *
+ * @return false if the buffer is exhausted
+ */
+inline bool next_line(std::string_view buffer, size_t &pos, std::string_view &line)
+{
+    if (pos >= buffer.size()) return false;
+    const char *begin = buffer.data() + pos;
+    const auto *end = static_cast<const char *>(std::memchr(begin, '\n', buffer.size() - pos));
+    if (end == nullptr) {
+        line = std::string_view(begin, buffer.size() - pos);
+        pos = buffer.size();
+    } else {
+        line = std::string_view(begin, static_cast<size_t>(end - begin));
+        pos += line.size() + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses an `@ KEY %type value` header line, `tokens` is scratch space
+ */
+template<typename real>
+auto parse_property(std::string_view line, std::vector<std::string_view> &tokens)
+    -> std::pair<std::string, data_value<real>>
+{
+    tokens.clear();
+    tokenize(line, tokens);
+    auto t = DT_from_string(tokens[2]);
+    std::string key(tokens[1]);
+
+    switch (t) {
+    case DataType::D:
+        return { key, data_value<real>(parse_int(tokens[3])) };
+    case DataType::LE:
+        return { key, data_value<real>(parse_real<double>(tokens[3])) };
+    case DataType::C:
+        return { key, data_value<real>(parse_complex<real>(tokens[3])) };
+    case DataType::B:
+        return { key, data_value<real>(parse_bool(tokens[3])) };
+    default: {
+        // collapse string
+        std::ostringstream ss;
+        std::copy(tokens.begin() + 3, tokens.end(), std::ostream_iterator<std::string_view>(ss, " "));
+        return { key, data_value<real>(ss.str()) };
+    }
+    }
+}
+
+/**
+ * @brief Appends the `@ KEY %type value` header line of a property to `out`
+ */
+template<typename real> void append_property(std::string &out, const std::string &key, const data_value<real> &value)
+{
+    char buffer[FORMAT_BUFFER];
+    out.append("@ ");
+    append_padded(out, key, 32);
+    out.push_back(' ');
+    append_padded(out, string_fromDT(value.type), 4);
+    out.push_back(' ');
+    switch (value.type) {
+    case DataType::LE:
+        out.append(format_real(buffer, value.get_double()));
+        break;
+    case DataType::D:
+        out.append(format_int(buffer, value.get_int()));
+        break;
+    case DataType::C: {
+        char complex_buffer[COMPLEX_FORMAT_BUFFER];
+        out.append(format_complex(complex_buffer, value.get_complex()));
+        break;
+    }
+    default:
+        out.append(value.pretty_print());
+        break;
+    }
+    out.push_back('\n');
+}
+
 // ---------------------------------------------------------------------------------------------
 // - implementation ----------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------
 
-template<typename real> dataframe<real>::dataframe(const std::string &path, const std::string &index)
+template<typename real, typename Alloc>
+dataframe<real, Alloc>::dataframe(const std::string &path, const read_options &options, const Alloc &alloc)
+    : allocator{ alloc }
+{
+    const auto start = detail::stats_clock::now();
+    const detail::allocation_snapshot allocations;
+    detail::stats_recorder recorder;
+    detail::stats_recorder *timing = options.stats != nullptr ? &recorder : nullptr;
+
+    source.path = path;
+    source.options = options;
+    if (options.binary_cache && read_cached(path, options)) {
+        // the sidecar knows nothing about offsets in the text file, so `refresh` reloads
+        source.path = path;
+        source.options = options;
+        source.valid = false;
+        recorder.header_end = start;
+    } else {
+        if (const auto c = detect_compression(path); c != compression::none) {
+            threaded_source in(open_source(path, c));
+            read_source(in, options, timing);
+        } else if (options.memory_map || options.threads != 1) {
+            mapped_file file(path);
+            read_buffer(file.view(), options, timing);
+        } else {
+            std::ifstream file(path);
+            read_stream(file, options, timing);
+        }
+        build_index(options.index);
+    }
+    // `refresh` reloads without statistics, the caller's struct may be long gone by then
+    source.options.stats = nullptr;
+
+    if (options.stats != nullptr) {
+        std::error_code ec;
+        const auto bytes = std::filesystem::file_size(path, ec);
+        std::vector<const column_type *> order;
+        for (auto &c : columns) order.push_back(&c);
+        record_stats(*options.stats, ec ? 0 : bytes, size(), order, start, allocations, recorder);
+    }
+}
+
+template<typename real, typename Alloc>
+bool dataframe<real, Alloc>::read_cached(const std::string &path, const read_options &options)
 {
-    std::ifstream file(path);
+    namespace fs = std::filesystem;
+
+    const std::string sidecar = path + ".bin";
+    std::error_code ec;
+    const auto text_time = fs::last_write_time(path, ec);
+    if (ec) return false;
+
+    const auto binary_time = fs::last_write_time(sidecar, ec);
+    if (!ec && binary_time >= text_time) {
+        try {
+            *this = load_binary(sidecar, options, allocator.alloc);
+            return true;
+        } catch (const std::runtime_error &) {
+            // written for another real type or damaged, replace it below
+        }
+    }
+
+    read_options full = options;
+    full.binary_cache = false;
+    full.columns.clear();
+    full.index.clear();
+    full.stats = nullptr;
+    dataframe parsed(path, full, allocator.alloc);
+
+    // write to a private temporary and rename, so concurrent readers, also in other processes, never
+    // see a partial sidecar
+    const std::string tmp = sidecar + "." + unique_file_suffix() + ".tmp";
+    try {
+        parsed.save_binary(tmp);
+        fs::rename(tmp, sidecar, ec);
+    } catch (const std::runtime_error &) {
+        // a cache that cannot be written is not an error, we just parse again next time
+    }
+    fs::remove(tmp, ec);
+
+    parsed.select_columns(options);
+    parsed.build_index(options.index);
+    *this = std::move(parsed);
+    return true;
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_stream(std::istream &stream,
+    const read_options &options,
+    detail::stats_recorder *recorder)
+{
+    read_header_stream(stream, options);
+    if (recorder != nullptr) recorder->header_end = detail::stats_clock::now();
+
     std::string line;
-    while (std::getline(file, line) && !ini_complete) {
-        if (line[0] == '@')
-            read_property(line);
-        else if (line[0] == '*')
-            read_column_headers(line);
-        else if (line[0] == '$')
-            read_column_types(line);
-        check_ini();
-    }
-    do {
-        read_line(line);
-    } while (std::getline(file, line));
+    std::string last;
+    uint64_t offset = source.header.size();
+    bool complete = source.header.empty() || source.header.back() == '\n';
+    while (std::getline(stream, line)) {
+        read_line(line, columns, recorder);
+        complete = !stream.eof();
+        offset += line.size() + (complete ? 1 : 0);
+        std::swap(line, last);
+    }
+    if (offset > source.header.size()) {
+        if (complete) last.push_back('\n');
+        source.tail.clear();
+        remember_tail(last);
+    }
+    source.parsed_end = offset;
+    source.complete = complete;
+    source.valid = true;
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_source(byte_source &in, const read_options &options, detail::stats_recorder *recorder)
+{
+    std::vector<std::string_view> tokens;
+    bool selected = false;
+    for_each_line(in, [&](std::string_view line) {
+        if (ini_complete) {
+            read_line(line, columns, recorder);
+            return;
+        }
+        read_header_line(line, tokens);
+        if (ini_complete) {
+            select_columns(options);
+            selected = true;
+            if (recorder != nullptr) recorder->header_end = detail::stats_clock::now();
+        }
+    });
+    if (!selected) select_columns(options);
+
+    // offsets in the decompressed data say nothing about the file, `refresh` always reloads
+    source.valid = false;
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_header_stream(std::istream &stream, const read_options &options)
+{
+    std::string line;
+    std::vector<std::string_view> tokens;
+    source.header.clear();
+    while (!ini_complete && std::getline(stream, line)) {
+        read_header_line(line, tokens);
+        source.header.append(line);
+        if (!stream.eof()) source.header.push_back('\n');
+    }
+    source.tail.clear();
+    remember_tail(source.header);
+    select_columns(options);
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::remember_tail(std::string_view parsed)
+{
+    if (parsed.size() >= REFRESH_TAIL_BYTES) {
+        source.tail.assign(parsed.substr(parsed.size() - REFRESH_TAIL_BYTES));
+        return;
+    }
+    source.tail.append(parsed);
+    if (source.tail.size() > REFRESH_TAIL_BYTES) source.tail.erase(0, source.tail.size() - REFRESH_TAIL_BYTES);
+}
+
+template<typename real, typename Alloc> auto dataframe<real, Alloc>::refresh() -> refresh_status
+{
+    auto reload = [this] {
+        read_options options = source.options;
+        options.binary_cache = false;
+        const std::string index = index_column;
+        *this = dataframe(source.path, options, allocator.alloc);
+        if (!index.empty() && index != options.index) set_index(index);
+        return refresh_status::reloaded;
+    };
+    if (source.path.empty()) throw std::runtime_error("dataframe was not read from a file");
+    if (!source.valid) return reload();
+
+    std::ifstream file(source.path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("could not open file " + source.path);
+    file.seekg(0, std::ios::end);
+    const auto size = static_cast<uint64_t>(file.tellg());
+    if (size < source.parsed_end) return reload();
+
+    // the header and the bytes before the end of the parsed rows must not have changed
+    std::string check(source.header.size(), '\0');
+    file.seekg(0);
+    file.read(check.data(), static_cast<std::streamsize>(check.size()));
+    if (!file || check != source.header) return reload();
+    check.resize(source.tail.size());
+    file.seekg(static_cast<std::streamoff>(source.parsed_end - source.tail.size()));
+    file.read(check.data(), static_cast<std::streamsize>(check.size()));
+    if (!file || check != source.tail) return reload();
+
+    if (size == source.parsed_end) return refresh_status::unchanged;
+    if (!source.complete) return reload();
+
+    std::string appended(size - source.parsed_end, '\0');
+    file.read(appended.data(), static_cast<std::streamsize>(appended.size()));
+    appended.resize(static_cast<size_t>(file.gcount()));
+    const size_t last_newline = appended.rfind('\n');
+    if (last_newline == std::string::npos) return refresh_status::unchanged;
+
+    read_appended(std::string_view(appended).substr(0, last_newline + 1));
+    return refresh_status::appended;
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::read_appended(std::string_view appended)
+{
+    const size_t old_rows = size();
+
+    size_t threads = source.options.threads == 0 ? thread_pool::default_size() : source.options.threads;
+    threads = std::min(threads, appended.size() / PARALLEL_MIN_CHUNK + 1);
+    if (threads > 1) {
+        read_body_parallel(appended, threads, nullptr);
+    } else {
+        size_t pos = 0;
+        std::string_view line;
+        while (next_line(appended, pos, line)) read_line(line, columns);
+    }
+
+    source.parsed_end += appended.size();
+    remember_tail(appended);
+
+    if (index_column.empty()) return;
+    const auto &keys = get_column(index_column);
+    for (size_t row = old_rows; row < keys.size(); row++) idx.insert(keys.string_at(row), row);
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_buffer(std::string_view buffer,
+    const read_options &options,
+    detail::stats_recorder *recorder)
+{
+    size_t pos = 0;
+    std::string_view line;
+    std::vector<std::string_view> tokens;
+    while (!ini_complete && next_line(buffer, pos, line)) read_header_line(line, tokens);
+    select_columns(options);
+    if (recorder != nullptr) recorder->header_end = detail::stats_clock::now();
+
+    const std::string_view body = buffer.substr(pos);
+    source.header.assign(buffer.substr(0, pos));
+    source.tail.assign(buffer.substr(buffer.size() - std::min(buffer.size(), REFRESH_TAIL_BYTES)));
+    source.parsed_end = buffer.size();
+    source.complete = buffer.empty() || buffer.back() == '\n';
+    source.valid = true;
+
+    size_t threads = options.threads == 0 ? thread_pool::default_size() : options.threads;
+    threads = std::min(threads, body.size() / PARALLEL_MIN_CHUNK + 1);
+    if (threads > 1) {
+        read_body_parallel(body, threads, recorder);
+        return;
+    }
+
+    pos = 0;
+    while (next_line(body, pos, line)) read_line(line, columns, recorder);
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_body_parallel(std::string_view body, size_t threads, detail::stats_recorder *recorder)
+{
+    std::vector<std::string_view> chunks;
+    const size_t chunk_size = body.size() / threads + 1;
+    for (size_t begin = 0; begin < body.size();) {
+        size_t end = begin + chunk_size;
+        if (end < body.size()) {
+            end = body.find('\n', end);
+            end = end == std::string_view::npos ? body.size() : end + 1;
+        } else {
+            end = body.size();
+        }
+        chunks.push_back(body.substr(begin, end - begin));
+        begin = end;
+    }
+
+    // every chunk times its own sampled rows, merged once all are done
+    std::vector<detail::stats_recorder> recorders(recorder != nullptr ? chunks.size() : 0);
+    std::vector<std::future<std::vector<column_type>>> futures;
+    futures.reserve(chunks.size());
+    {
+        thread_pool pool(chunks.size());
+        for (size_t i = 0; i < chunks.size(); i++) {
+            auto *chunk_recorder = recorder != nullptr ? &recorders[i] : nullptr;
+            futures.push_back(pool.submit([this, chunk = chunks[i], chunk_recorder] {
+                return read_chunk(chunk, chunk_recorder);
+            }));
+        }
+    }
+    for (auto &r : recorders) recorder->merge(r);
+
+    std::vector<std::vector<column_type>> fragments;
+    fragments.reserve(futures.size());
+    for (auto &f : futures) fragments.push_back(f.get());
+
+    for (size_t i = 0; i < columns.size(); i++) {
+        size_t total = columns[i].size();
+        for (auto &fragment : fragments) total += fragment[i].size();
+        columns[i].reserve(total);
+        for (auto &fragment : fragments) columns[i].append(std::move(fragment[i]));
+    }
+}
+
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::read_chunk(std::string_view chunk, detail::stats_recorder *recorder) const
+    -> std::vector<column_type>
+{
+    std::vector<column_type> fragment;
+    fragment.reserve(columns.size());
+    for (auto &c : columns) {
+        fragment.emplace_back(c.type, c.name);
+        if (c.compact) fragment.back().make_compact();
+    }
+
+    size_t pos = 0;
+    std::string_view line;
+    while (next_line(chunk, pos, line)) read_line(line, fragment, recorder);
+    return fragment;
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_header_line(std::string_view line, std::vector<std::string_view> &tokens)
+{
+    if (line.empty()) return;
+
+    if (line[0] == '@')
+        read_property(line, tokens);
+    else if (line[0] == '*')
+        read_column_headers(line, tokens);
+    else if (line[0] == '$')
+        read_column_types(line, tokens);
+    check_ini();
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::select_columns(const read_options &options)
+{
+    for (auto &kvp : column_headers) {
+        if (kvp.second < columns.size()) columns[kvp.second].name = kvp.first;
+    }
+
+    if (options.compact_strings) {
+        for (auto &c : columns) {
+            if (c.type == DataType::S) c.make_compact();
+        }
+    }
+
+    projection.resize(columns.size());
+    if (options.columns.empty()) {
+        for (size_t i = 0; i < projection.size(); i++) projection[i] = i;
+        index_columns();
+        return;
+    }
+
+    std::vector<std::string> wanted = options.columns;
+    if (!options.index.empty()) wanted.push_back(options.index);
 
+    std::vector<bool> keep(columns.size(), false);
+    for (auto &name : wanted) {
+        auto it = column_headers.find(name);
+        if (it == column_headers.end()) throw std::runtime_error("column " + name + " not found");
+        keep[it->second] = true;
+    }
+
+    std::vector<column_type> selected;
+    column_headers.clear();
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (!keep[i]) {
+            projection[i] = SKIP;
+            continue;
+        }
+        projection[i] = selected.size();
+        column_headers[columns[i].name] = selected.size();
+        selected.push_back(std::move(columns[i]));
+    }
+    columns = std::move(selected);
+
+    while (!projection.empty() && projection.back() == SKIP) projection.pop_back();
+    index_columns();
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::build_index(const std::string &index)
+{
     if (index.empty()) return;
-    auto &index_col = get_column(index).payload.string_vector;
-    for (int i = 0; i < index_col.size(); i++) idx.insert(std::make_pair(index_col[i], i));
+    set_index(index);
 }
 
-template<typename real> data_vector<real> &dataframe<real>::get_column(const std::string &name)
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::set_index(const std::string &column) -> const std::vector<std::string> &
 {
-    return columns[column_headers[name]];
+    const auto &index_col = get_column(column);
+    idx = hash_index::build(index_col.size(), [&index_col](size_t i) { return index_col.string_at(i); });
+    index_column = column;
+    return idx.duplicates();
 }
 
-template<typename real> void dataframe<real>::to_file(const std::string &filename)
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::select(const bit_column &mask, size_t threads) const -> dataframe
 {
-    std::ofstream file(filename);
+    if (mask.size() != size()) throw std::runtime_error("mask length differs from the number of rows");
+    dataframe df(allocator.alloc);
+    df.properties = properties;
+    df.column_headers = column_headers;
+    df.columns = gather_columns(
+        columns.size(), [this, &mask](size_t i) { return columns[i].gather(mask); }, threads);
+    df.index_columns();
+    df.ini_complete = true;
+    return df;
+}
 
-    if (!file.is_open()) return;
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::select(const std::vector<size_t> &rows, size_t threads) const -> dataframe
+{
+    dataframe df(allocator.alloc);
+    df.properties = properties;
+    df.column_headers = column_headers;
+    df.columns = gather_columns(
+        columns.size(), [this, &rows](size_t i) { return columns[i].gather(rows); }, threads);
+    df.index_columns();
+    df.ini_complete = true;
+    return df;
+}
+
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::join(const dataframe &right, const std::string &key, const join_options &options) const
+    -> dataframe
+{
+    const auto &left_key = get_column(key);
+    const auto &right_key = right.get_column(key);
+    if (left_key.type != DataType::S || right_key.type != DataType::S)
+        throw std::runtime_error("join key " + key + " is not a string column");
+
+    const size_t n_left = left_key.size();
+    const size_t n_right = right_key.size();
+    const bool left_outer = options.how == join_type::left;
+
+    // hash table over the smaller side, further rows with the same key are chained through `next`
+    const bool build_left = n_left < n_right;
+    const auto &build_key = build_left ? left_key : right_key;
+    const auto &probe_key = build_left ? right_key : left_key;
+    hash_index table;
+    table.reserve(build_key.size());
+    std::vector<size_t> next(build_key.size(), MISSING_ROW);
+    std::vector<size_t> tail(build_key.size());
+    for (size_t i = 0; i < build_key.size(); i++) {
+        const auto k = build_key.string_at(i);
+        if (table.insert(k, i)) {
+            tail[i] = i;
+            continue;
+        }
+        const size_t head = table.find(k);
+        next[tail[head]] = i;
+        tail[head] = i;
+    }
 
+    std::vector<size_t> left_rows;
+    std::vector<size_t> right_rows;
+    if (!build_left) {
+        left_rows.reserve(n_left);
+        right_rows.reserve(n_left);
+        for (size_t l = 0; l < n_left; l++) {
+            const size_t head = table.find(probe_key.string_at(l));
+            if (head == hash_index::npos) {
+                if (left_outer) {
+                    left_rows.push_back(l);
+                    right_rows.push_back(MISSING_ROW);
+                }
+                continue;
+            }
+            for (size_t r = head; r != MISSING_ROW; r = next[r]) {
+                left_rows.push_back(l);
+                right_rows.push_back(r);
+            }
+        }
+    } else {
+        // probing with the right rows finds the pairs out of order, place them by left row
+        std::vector<size_t> heads(n_right);
+        std::vector<size_t> offsets(n_left + 1, 0);
+        for (size_t r = 0; r < n_right; r++) {
+            heads[r] = table.find(probe_key.string_at(r));
+            if (heads[r] == hash_index::npos) continue;
+            for (size_t l = heads[r]; l != MISSING_ROW; l = next[l]) offsets[l + 1]++;
+        }
+        for (size_t l = 0; l < n_left; l++) {
+            if (left_outer && offsets[l + 1] == 0) offsets[l + 1] = 1;
+            offsets[l + 1] += offsets[l];
+        }
+        left_rows.resize(offsets[n_left]);
+        right_rows.assign(offsets[n_left], MISSING_ROW);
+        for (size_t l = 0; l < n_left; l++) {
+            for (size_t pos = offsets[l]; pos < offsets[l + 1]; pos++) left_rows[pos] = l;
+        }
+        for (size_t r = 0; r < n_right; r++) {
+            if (heads[r] == hash_index::npos) continue;
+            for (size_t l = heads[r]; l != MISSING_ROW; l = next[l]) right_rows[offsets[l]++] = r;
+        }
+    }
+
+    struct source
+    {
+        const column_type *column;
+        std::string name;
+        bool from_left;
+    };
+    std::vector<source> sources;
+    for (auto &kvp : column_headers) {
+        const bool collision = kvp.first != key && right.has_column(kvp.first);
+        sources.push_back({ &columns[kvp.second], kvp.first + (collision ? options.left_suffix : ""), true });
+    }
+    for (auto &kvp : right.column_headers) {
+        if (kvp.first == key) continue;
+        const bool collision = has_column(kvp.first);
+        sources.push_back({ &right.columns[kvp.second], kvp.first + (collision ? options.right_suffix : ""), false });
+    }
+
+    dataframe df(allocator.alloc);
+    df.properties = properties;
+    df.columns = gather_columns(
+        sources.size(),
+        [&](size_t i) {
+            auto c = sources[i].from_left ? sources[i].column->gather(left_rows)
+                                          : sources[i].column->gather_or_missing(right_rows);
+            c.name = sources[i].name;
+            return c;
+        },
+        options.threads);
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (!df.column_headers.emplace(sources[i].name, i).second)
+            throw std::runtime_error("joined column name " + sources[i].name + " is not unique");
+    }
+    df.index_columns();
+    df.ini_complete = true;
+    return df;
+}
+
+template<typename real, typename Alloc>
+template<typename F>
+auto dataframe<real, Alloc>::gather_columns(size_t n, F &&gather_one, size_t threads) -> std::vector<column_type>
+{
+    std::vector<column_type> out;
+    out.reserve(n);
+    if (threads == 0) threads = thread_pool::default_size();
+    threads = std::min(threads, n);
+    if (threads <= 1) {
+        for (size_t i = 0; i < n; i++) out.push_back(gather_one(i));
+        return out;
+    }
+
+    thread_pool pool(threads);
+    std::vector<std::future<column_type>> gathered;
+    gathered.reserve(n);
+    for (size_t i = 0; i < n; i++) gathered.push_back(pool.submit([&gather_one, i] { return gather_one(i); }));
+    for (auto &f : gathered) out.push_back(f.get());
+    return out;
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::register_column(const std::string &name)
+{
+    column_headers[name] = columns.size();
+    column_index.assign(name, columns.size());
+}
+
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::column_pointers(const std::vector<std::string> &names) const
+    -> std::vector<const column_type *>
+{
+    std::vector<const column_type *> out;
+    out.reserve(names.size());
+    for (auto &name : names) out.push_back(&get_column(name));
+    return out;
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::index_columns()
+{
+    column_index.clear();
+    column_index.reserve(column_headers.size());
+    for (auto &kvp : column_headers) column_index.assign(kvp.first, kvp.second);
+}
+
+template<typename real, typename Alloc>
+data_vector<real, Alloc> &dataframe<real, Alloc>::get_column(const std::string &name)
+{
+    const size_t i = column_index.find(name);
+    if (i == hash_index::npos) throw std::runtime_error("column " + name + " not found");
+    return columns[i];
+}
+
+template<typename real, typename Alloc>
+const data_vector<real, Alloc> &dataframe<real, Alloc>::get_column(const std::string &name) const
+{
+    const size_t i = column_index.find(name);
+    if (i == hash_index::npos) throw std::runtime_error("column " + name + " not found");
+    return columns[i];
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::to_file(const std::string &filename, const write_options &options) const
+{
+    std::vector<std::string> names;
+    std::vector<const column_type *> order;
+    order.reserve(column_headers.size());
+    for (auto &c : column_headers) {
+        names.push_back(c.first);
+        order.push_back(&columns[c.second]);
+    }
+    write_rows(filename, options, names, order, 0, size());
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::write_rows(const std::string &filename,
+    const write_options &options,
+    const std::vector<std::string> &names,
+    const std::vector<const column_type *> &order,
+    size_t begin_row,
+    size_t end_row) const
+{
+    const auto start = detail::stats_clock::now();
+    const detail::allocation_snapshot allocations;
+    detail::stats_recorder recorder;
+    detail::stats_recorder *timing = options.stats != nullptr ? &recorder : nullptr;
+
+    const auto file = open_sink(filename, options.compress);
+
+    std::string out;
+    format_header(out, names, order);
+    file->write(out.data(), out.size());
+    recorder.header_end = detail::stats_clock::now();
+
+    const size_t rows = end_row - begin_row;
+    size_t threads = options.threads == 0 ? thread_pool::default_size() : options.threads;
+    threads = std::min(threads, rows / WRITE_BLOCK_ROWS + 1);
+
+    if (threads <= 1) {
+        for (size_t begin = begin_row; begin < end_row; begin += WRITE_BLOCK_ROWS) {
+            out.clear();
+            format_rows(order, begin, std::min(begin + WRITE_BLOCK_ROWS, end_row), out, timing);
+            file->write(out.data(), out.size());
+        }
+    } else {
+        std::vector<std::string> buffers(threads);
+        std::vector<detail::stats_recorder> recorders(timing != nullptr ? threads : 0);
+        std::vector<std::future<void>> futures;
+        // after the buffers, so that when a write throws the pool finishes its tasks before they are freed
+        thread_pool pool(threads);
+        for (size_t round = begin_row; round < end_row; round += threads * WRITE_BLOCK_ROWS) {
+            futures.clear();
+            for (size_t t = 0; t < threads && round + t * WRITE_BLOCK_ROWS < end_row; t++) {
+                const size_t begin = round + t * WRITE_BLOCK_ROWS;
+                const size_t end = std::min(begin + WRITE_BLOCK_ROWS, end_row);
+                auto *block_recorder = timing != nullptr ? &recorders[t] : nullptr;
+                futures.push_back(pool.submit([this, &order, &buffers, t, begin, end, block_recorder] {
+                    buffers[t].clear();
+                    format_rows(order, begin, end, buffers[t], block_recorder);
+                }));
+            }
+            for (size_t t = 0; t < futures.size(); t++) {
+                futures[t].get();
+                file->write(buffers[t].data(), buffers[t].size());
+            }
+        }
+        for (auto &r : recorders) recorder.merge(r);
+    }
+    file->finish();
+
+    if (options.stats != nullptr) {
+        std::error_code ec;
+        const auto bytes = std::filesystem::file_size(filename, ec);
+        record_stats(*options.stats, ec ? 0 : bytes, rows, order, start, allocations, recorder);
+    }
+}
+
+template<typename real, typename Alloc> void dataframe<real, Alloc>::save_binary(const std::string &filename) const
+{
+    static_assert(sizeof(int) == sizeof(int32_t));
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("could not open file " + filename);
+
+    binary_writer out(file);
+    out.bytes(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    out.value<uint32_t>(BINARY_BYTE_ORDER);
+    out.value<uint32_t>(sizeof(real));
+
+    out.value<uint64_t>(properties.size());
     for (auto &kvp : properties) {
-        file << "@ " << std::setw(32) << kvp.first << " " << std::setw(4) << string_fromDT(kvp.second.type) << " "
-             << kvp.second << "\n";
+        out.string(kvp.first);
+        out.value<uint32_t>(kvp.second.type);
+        switch (kvp.second.type) {
+        case DataType::LE:
+            out.value<double>(kvp.second.get_double());
+            break;
+        case DataType::D:
+            out.value<int64_t>(kvp.second.get_int());
+            break;
+        case DataType::S:
+            out.string(kvp.second.get_string());
+            break;
+        case DataType::B:
+            out.value<uint8_t>(std::get<bool>(kvp.second.payload));
+            break;
+        case DataType::C:
+            out.value<double>(kvp.second.get_complex().real());
+            out.value<double>(kvp.second.get_complex().imag());
+            break;
+        }
     }
-    file << "* ";
-    for (auto &kvp : column_headers) file << std::setw(FIELDWIDTH) << kvp.first << " ";
-    file << "\n$ ";
-    for (auto &c : column_headers) file << std::setw(FIELDWIDTH) << string_fromDT(columns[c.second].type) << " ";
-    file << "\n";
 
-    for (int i = 0; i < size(); i++) {
-        file << "  ";
-        for (auto &c : column_headers) columns[c.second].print_at(i, file);
-        file << "\n";
+    std::vector<std::string_view> names(columns.size());
+    for (auto &kvp : column_headers) names[kvp.second] = kvp.first;
+
+    out.value<uint64_t>(columns.size());
+    for (size_t i = 0; i < columns.size(); i++) {
+        const auto &col = columns[i];
+        const size_t count = col.size();
+        out.string(names[i]);
+        out.value<uint32_t>(col.type);
+        out.value<uint64_t>(count);
+
+        switch (col.type) {
+        case DataType::LE:
+            out.value<uint64_t>(count * sizeof(real));
+            out.align();
+            out.bytes(col.payload.double_vector.data(), count * sizeof(real));
+            break;
+        case DataType::D:
+            out.value<uint64_t>(count * sizeof(int32_t));
+            out.align();
+            out.bytes(col.payload.int_vector.data(), count * sizeof(int32_t));
+            break;
+        case DataType::S: {
+            std::vector<uint64_t> offsets(count + 1, 0);
+            for (size_t j = 0; j < count; j++) offsets[j + 1] = offsets[j] + col.string_at(j).size();
+            out.value<uint64_t>((count + 1) * sizeof(uint64_t) + offsets[count]);
+            out.align();
+            out.bytes(offsets.data(), offsets.size() * sizeof(uint64_t));
+            for (size_t j = 0; j < count; j++) out.bytes(col.string_at(j).data(), col.string_at(j).size());
+            break;
+        }
+        case DataType::B:
+            out.value<uint64_t>(col.payload.bool_column.word_size() * sizeof(uint64_t));
+            out.align();
+            out.bytes(col.payload.bool_column.data(), col.payload.bool_column.word_size() * sizeof(uint64_t));
+            break;
+        case DataType::C:
+            out.value<uint64_t>(2 * count * sizeof(real));
+            out.align();
+            out.bytes(col.payload.complex_vector.re.data(), count * sizeof(real));
+            out.bytes(col.payload.complex_vector.im.data(), count * sizeof(real));
+            break;
+        }
     }
-    file.close();
+
+    if (!file) throw std::runtime_error("could not write file " + filename);
 }
 
-template<typename real> void dataframe<real>::read_property(const std::string &line)
+template<typename real, typename Alloc>
+auto dataframe<real, Alloc>::load_binary(const std::string &filename, const read_options &options, const Alloc &alloc)
+    -> dataframe
 {
-    std::vector<std::string> tokens;
-    tokenize(line, tokens);
-    auto t = DT_from_string(tokens[2]);
+    mapped_file file(filename);
+    binary_reader in(file.view());
 
-    switch (t) {
-    case DataType::D: {
-        char *pEnd;
-        properties.insert(std::make_pair(tokens[1], data_value<real>((int)strtol(tokens[3].c_str(), &pEnd, 10))));
-        break;
+    if (std::memcmp(in.bytes(sizeof(BINARY_MAGIC)), BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+        throw std::runtime_error(filename + " is not a binary tfs file");
+    if (in.value<uint32_t>() != BINARY_BYTE_ORDER)
+        throw std::runtime_error(filename + " was written with a different byte order");
+    if (in.value<uint32_t>() != sizeof(real))
+        throw std::runtime_error(filename + " was written for a different real type");
+
+    dataframe df(alloc);
+    const auto n_properties = in.value<uint64_t>();
+    for (uint64_t i = 0; i < n_properties; i++) {
+        std::string key(in.string());
+        const auto t = static_cast<DataType>(in.value<uint32_t>());
+        switch (t) {
+        case DataType::LE:
+            df.properties.insert(std::make_pair(key, data_value<real>(in.value<double>())));
+            break;
+        case DataType::D:
+            df.properties.insert(std::make_pair(key, data_value<real>(static_cast<int>(in.value<int64_t>()))));
+            break;
+        case DataType::S:
+            df.properties.insert(std::make_pair(key, data_value<real>(std::string(in.string()))));
+            break;
+        case DataType::B:
+            df.properties.insert(std::make_pair(key, data_value<real>(in.value<uint8_t>() != 0)));
+            break;
+        case DataType::C: {
+            const auto re = static_cast<real>(in.value<double>());
+            const auto im = static_cast<real>(in.value<double>());
+            df.properties.insert(std::make_pair(key, data_value<real>(std::complex<real>(re, im))));
+            break;
+        }
+        default:
+            throw std::runtime_error(filename + " contains an unknown property type");
+        }
     }
-    case DataType::LE: {
-        char *pEnd;
-        properties.insert(std::make_pair(tokens[1], data_value<real>(strtod(tokens[3].c_str(), &pEnd))));
-        break;
+
+    std::vector<std::string> wanted = options.columns;
+    if (!wanted.empty() && !options.index.empty()) wanted.push_back(options.index);
+
+    const auto n_columns = in.value<uint64_t>();
+    for (uint64_t i = 0; i < n_columns; i++) {
+        std::string name(in.string());
+        const auto t = static_cast<DataType>(in.value<uint32_t>());
+        const auto count = static_cast<size_t>(in.value<uint64_t>());
+        const auto n_bytes = static_cast<size_t>(in.value<uint64_t>());
+        in.align();
+        const char *data = in.bytes(n_bytes);
+
+        if (!wanted.empty() && std::find(wanted.begin(), wanted.end(), name) == wanted.end()) continue;
+
+        auto &col = df.add_column(name, t);
+        if (t == DataType::S && options.compact_strings) col.make_compact();
+        switch (t) {
+        case DataType::LE:
+            if (n_bytes != count * sizeof(real)) throw std::runtime_error("corrupt column " + name);
+            col.payload.double_vector.resize(count);
+            std::memcpy(col.payload.double_vector.data(), data, n_bytes);
+            break;
+        case DataType::D:
+            if (n_bytes != count * sizeof(int32_t)) throw std::runtime_error("corrupt column " + name);
+            col.payload.int_vector.resize(count);
+            std::memcpy(col.payload.int_vector.data(), data, n_bytes);
+            break;
+        case DataType::S: {
+            const size_t table = (count + 1) * sizeof(uint64_t);
+            if (n_bytes < table) throw std::runtime_error("corrupt column " + name);
+            std::vector<uint64_t> offsets(count + 1);
+            std::memcpy(offsets.data(), data, table);
+            if (offsets[count] != n_bytes - table) throw std::runtime_error("corrupt column " + name);
+            const char *chars = data + table;
+            col.reserve(count);
+            for (size_t j = 0; j < count; j++) {
+                if (offsets[j + 1] < offsets[j]) throw std::runtime_error("corrupt column " + name);
+                col.convert_back(std::string_view(chars + offsets[j], offsets[j + 1] - offsets[j]));
+            }
+            break;
+        }
+        case DataType::B:
+            col.payload.bool_column.resize(count);
+            if (n_bytes != col.payload.bool_column.word_size() * sizeof(uint64_t))
+                throw std::runtime_error("corrupt column " + name);
+            std::memcpy(col.payload.bool_column.data(), data, n_bytes);
+            break;
+        case DataType::C:
+            if (n_bytes != 2 * count * sizeof(real)) throw std::runtime_error("corrupt column " + name);
+            col.payload.complex_vector.resize(count);
+            std::memcpy(col.payload.complex_vector.re.data(), data, count * sizeof(real));
+            std::memcpy(col.payload.complex_vector.im.data(), data + count * sizeof(real), count * sizeof(real));
+            break;
+        default:
+            throw std::runtime_error(filename + " contains an unknown column type");
+        }
     }
 
-    default:
-        // collapse string
-        std::ostringstream ss;
-        std::copy(tokens.begin() + 3, tokens.end(), std::ostream_iterator<std::string>(ss, " "));
-        properties.insert(std::make_pair(tokens[1], ss.str()));
+    for (auto &name : wanted) {
+        if (df.column_headers.find(name) == df.column_headers.end())
+            throw std::runtime_error("column " + name + " not found");
     }
+
+    df.ini_complete = true;
+    df.build_index(options.index);
+    return df;
 }
 
-template<typename real> void dataframe<real>::read_column_headers(const std::string &line)
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::format_header(std::string &out,
+    const std::vector<std::string> &names,
+    const std::vector<const column_type *> &order) const
 {
-    std::vector<std::string> tokens;
-    tokenize(line, tokens);
+    for (auto &kvp : properties) append_property(out, kvp.first, kvp.second);
 
-    for (int i = 0; i < tokens.size() - 1; i++) column_headers.insert(std::make_pair(tokens[i + 1], i));
+    out.append("* ");
+    for (auto &name : names) {
+        append_padded(out, name, FIELDWIDTH);
+        out.push_back(' ');
+    }
+    out.append("\n$ ");
+    for (auto *c : order) {
+        append_padded(out, string_fromDT(c->type), FIELDWIDTH);
+        out.push_back(' ');
+    }
+    out.push_back('\n');
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::format_rows(const std::vector<const column_type *> &order,
+    size_t begin,
+    size_t end,
+    std::string &out,
+    detail::stats_recorder *recorder) const
+{
+    for (size_t i = begin; i < end; i++) {
+        out.append("  ");
+        if (recorder != nullptr && recorder->sample()) {
+            for (size_t c = 0; c < order.size(); c++) {
+                const auto start = detail::stats_clock::now();
+                order[c]->format_at(i, out);
+                recorder->add(c, start);
+            }
+        } else {
+            for (auto *c : order) c->format_at(i, out);
+        }
+        out.push_back('\n');
+    }
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::record_stats(io_stats &stats,
+    uint64_t bytes,
+    size_t rows,
+    const std::vector<const column_type *> &order,
+    detail::stats_clock::time_point start,
+    const detail::allocation_snapshot &allocations,
+    const detail::stats_recorder &recorder) const
+{
+    const auto end = detail::stats_clock::now();
+    allocations.record(stats);
+    stats.bytes = bytes;
+    stats.rows = rows;
+    stats.cells = rows * order.size();
+    stats.header_seconds = std::chrono::duration<double>(recorder.header_end - start).count();
+    stats.body_seconds = std::chrono::duration<double>(end - recorder.header_end).count();
+    stats.columns.clear();
+    for (size_t i = 0; i < order.size(); i++) {
+        stats.columns.push_back({ order[i]->name, order[i]->type, recorder.estimate(i), order[i]->memory_usage() });
+    }
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_property(std::string_view line, std::vector<std::string_view> &tokens)
+{
+    properties.insert(parse_property<real>(line, tokens));
 }
 
-template<typename real> void dataframe<real>::read_column_types(const std::string &line)
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_column_headers(std::string_view line, std::vector<std::string_view> &tokens)
 {
-    std::vector<std::string> tokens;
+    tokens.clear();
     tokenize(line, tokens);
 
-    for (auto it = tokens.begin() + 1; it != tokens.end(); ++it) { columns.emplace_back(DT_from_string(*it), ""); }
+    for (size_t i = 0; i < tokens.size() - 1; i++) column_headers.insert(std::make_pair(std::string(tokens[i + 1]), i));
 }
 
-template<typename real> void dataframe<real>::read_line(const std::string &line)
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_column_types(std::string_view line, std::vector<std::string_view> &tokens)
 {
-    std::vector<std::string> tokens;
+    tokens.clear();
     tokenize(line, tokens);
 
+    for (auto it = tokens.begin() + 1; it != tokens.end(); ++it) {
+        columns.emplace_back(DT_from_string(*it), "", allocator.alloc);
+    }
+}
+
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_line(std::string_view line, std::vector<column_type> &dest) const
+{
+    size_t pos = 0;
+    std::string_view token;
+    for (size_t field = 0; field < projection.size() && next_token(line, pos, token); field++) {
+        if (projection[field] != SKIP) dest[projection[field]].convert_back(token);
+    }
+}
 
-    for (int i = 0; i < tokens.size(); i++) { columns[i].convert_back(tokens[i]); }
+template<typename real, typename Alloc>
+void dataframe<real, Alloc>::read_line(std::string_view line,
+    std::vector<column_type> &dest,
+    detail::stats_recorder *recorder) const
+{
+    if (recorder == nullptr || !recorder->sample()) {
+        read_line(line, dest);
+        return;
+    }
+    size_t pos = 0;
+    std::string_view token;
+    for (size_t field = 0; field < projection.size() && next_token(line, pos, token); field++) {
+        if (projection[field] == SKIP) continue;
+        const auto start = detail::stats_clock::now();
+        dest[projection[field]].convert_back(token);
+        recorder->add(projection[field], start);
+    }
 }
 
-template<typename real> void dataframe<real>::check_ini()
+template<typename real, typename Alloc> void dataframe<real, Alloc>::check_ini()
 {
     if (columns.size() > 0 && columns.size() == column_headers.size()) ini_complete = true;
 }
 
-template<typename real> std::string dataframe<real>::pretty_print() const
+template<typename real, typename Alloc> std::string dataframe<real, Alloc>::pretty_print() const
 {
     std::ostringstream ss;
     ss << "DataFrame{\n";
@@ -327,7 +1766,7 @@ template<typename real> std::string dataframe<real>::pretty_print() const
     return ss.str();
 }
 
-template<typename real> void dataframe<real>::verify() const
+template<typename real, typename Alloc> void dataframe<real, Alloc>::verify() const
 {
     using std::cout;
     using std::endl;
@@ -338,9 +1777,14 @@ template<typename real> void dataframe<real>::verify() const
 
     cout << endl;
 }
-template<typename real> std::ostream &operator<<(std::ostream &os, const dataframe<real> &df)
+template<typename real, typename Alloc> std::ostream &operator<<(std::ostream &os, const dataframe<real, Alloc> &df)
 {
     return (os << df.pretty_print());
 }
 
+namespace pmr {
+    /// dataframe whose columns allocate from a `std::pmr::memory_resource`
+    template<typename real = double> using dataframe = tfs::dataframe<real, std::pmr::polymorphic_allocator<char>>;
+}// namespace pmr
+
 }// namespace tfs
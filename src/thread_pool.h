@@ -0,0 +1,118 @@
+#pragma once
+
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tfs {
+
+/**
+ * @brief Fixed size pool of worker threads processing a FIFO task queue.
+ *
+ * The destructor finishes all queued tasks before joining the workers.
+ */
+class thread_pool
+{
+  public:
+    /**
+     * @brief Starts `n` workers, `0` means one per hardware thread
+     */
+    explicit thread_pool(size_t n = 0)
+    {
+        if (n == 0) n = default_size();
+        workers.reserve(n);
+        for (size_t i = 0; i < n; i++) workers.emplace_back([this] { work(); });
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto &w : workers) w.join();
+    }
+
+    /**
+     * @brief Queues `f` and returns a future for its result
+     */
+    template<typename F> auto submit(F &&f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using result_type = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([task] { (*task)(); });
+        }
+        wakeup.notify_one();
+        return future;
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return workers.size(); }
+
+    /**
+     * @brief Number of hardware threads, at least 1
+     */
+    static auto default_size() -> size_t
+    {
+        const size_t n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+  private:
+    void work()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+};
+
+namespace detail {
+
+    /**
+     * @brief Runs `tasks` tasks, on a pool of `threads` workers if that is more than one
+     */
+    template<typename F> void run_tasks(size_t tasks, size_t threads, F &&task)
+    {
+        threads = std::min(threads == 0 ? thread_pool::default_size() : threads, tasks);
+        if (threads <= 1) {
+            for (size_t t = 0; t < tasks; t++) task(t);
+            return;
+        }
+        thread_pool pool(threads);
+        std::vector<std::future<void>> done;
+        done.reserve(tasks);
+        for (size_t t = 0; t < tasks; t++) done.push_back(pool.submit([&task, t] { task(t); }));
+        for (auto &d : done) d.get();
+    }
+
+}// namespace detail
+
+}// namespace tfs
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bit_column.h"
+#include "complex_column.h"
+#include "tfs_dataframe.h"
+
+namespace tfs {
+
+// ----------------------------------------------------------------------------------------
+// ---- Schema ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------
+//
+// A schema lists the columns of a file layout that is known at compile time. Every column is a tag
+// type deriving from one of the field kinds below and naming itself:
+//
+//     TFS_COLUMN(BETX, real_field);
+//     using twiss_schema = tfs::schema<NAME, S, BETX>;
+//
+// `typed_dataframe<twiss_schema>` then stores the columns in a tuple of concretely typed vectors and
+// parses and formats rows with code generated per column, so no cell goes through a type switch.
+
+struct real_field
+{
+    using kind = real_field;
+};
+struct int_field
+{
+    using kind = int_field;
+};
+struct string_field
+{
+    using kind = string_field;
+};
+struct bool_field
+{
+    using kind = bool_field;
+};
+struct complex_field
+{
+    using kind = complex_field;
+};
+
+/// declares the column tag `NAME` of kind `KIND`, named like the tag in the file
+#define TFS_COLUMN(NAME, KIND)                          \
+    struct NAME : ::tfs::KIND                           \
+    {                                                   \
+        static constexpr std::string_view name = #NAME; \
+    }
+
+template<typename... Columns> struct schema
+{
+};
+
+/**
+ * @brief Storage, file type, parser and formatter of one field kind
+ */
+template<typename Kind, typename real> struct field_traits;
+
+template<typename real> struct field_traits<real_field, real>
+{
+    using storage = std::vector<real>;
+    static constexpr DataType type = DataType::LE;
+
+    static void parse(storage &v, std::string_view s) { v.push_back(parse_real<real>(s)); }
+    static void format(const storage &v, size_t i, std::string &out)
+    {
+        char buffer[FORMAT_BUFFER];
+        append_padded(out, format_real(buffer, v[i]), FIELDWIDTH);
+    }
+};
+
+template<typename real> struct field_traits<int_field, real>
+{
+    using storage = std::vector<int>;
+    static constexpr DataType type = DataType::D;
+
+    static void parse(storage &v, std::string_view s) { v.push_back(parse_int(s)); }
+    static void format(const storage &v, size_t i, std::string &out)
+    {
+        char buffer[FORMAT_BUFFER];
+        append_padded(out, format_int(buffer, v[i]), FIELDWIDTH);
+    }
+};
+
+template<typename real> struct field_traits<string_field, real>
+{
+    using storage = std::vector<std::string>;
+    static constexpr DataType type = DataType::S;
+
+    static void parse(storage &v, std::string_view s) { v.emplace_back(s); }
+    static void format(const storage &v, size_t i, std::string &out) { append_padded(out, v[i], FIELDWIDTH); }
+};
+
+template<typename real> struct field_traits<bool_field, real>
+{
+    using storage = bit_column;
+    static constexpr DataType type = DataType::B;
+
+    static void parse(storage &v, std::string_view s) { v.push_back(parse_bool(s)); }
+    static void format(const storage &v, size_t i, std::string &out)
+    {
+        append_padded(out, v[i] ? "True" : "False", FIELDWIDTH);
+    }
+};
+
+template<typename real> struct field_traits<complex_field, real>
+{
+    using storage = split_complex<real>;
+    static constexpr DataType type = DataType::C;
+
+    static void parse(storage &v, std::string_view s) { v.push_back(parse_complex<real>(s)); }
+    static void format(const storage &v, size_t i, std::string &out)
+    {
+        char buffer[COMPLEX_FORMAT_BUFFER];
+        append_padded(out, format_complex(buffer, v[i]), FIELDWIDTH);
+    }
+};
+
+template<typename Schema, typename real = double> class typed_dataframe;
+
+/**
+ * @brief Dataframe whose columns are fixed at compile time by a `schema`.
+ *
+ * Reading validates the `*` and `$` lines of the file against the schema: every schema column must
+ * be in the file with the same type, in the same relative order. Other columns of the file are
+ * skipped. Rows are then parsed by one unrolled sequence of "skip k fields, convert one field"
+ * steps, one per schema column.
+ *
+ * Columns are accessed with `get<C>()`, which resolves to a tuple element at compile time. `%le`
+ * columns are `std::vector<real>`, `%d` `std::vector<int>`, `%s` `std::vector<std::string>`, `%b`
+ * `bit_column` and `%lec` `split_complex<real>`.
+ */
+template<typename... Columns, typename real> class typed_dataframe<schema<Columns...>, real>
+{
+    static_assert(sizeof...(Columns) > 0, "a schema needs at least one column");
+
+  public:
+    static constexpr size_t COLUMNS = sizeof...(Columns);
+
+    template<typename C> using traits_t = field_traits<typename C::kind, real>;
+    template<typename C> using storage_t = typename traits_t<C>::storage;
+
+    typed_dataframe() = default;
+
+    /**
+     * @brief Reads `path`, decompressing gzip and zstd files like `dataframe` does. Throws if the
+     * header does not match the schema or a row has too few fields.
+     */
+    explicit typed_dataframe(const std::string &path)
+    {
+        std::vector<std::string_view> tokens;
+        auto parse = [&](std::string_view line) {
+            if (header_complete) {
+                if (line.find_first_not_of(' ') != std::string_view::npos) read_line(line);
+            } else {
+                read_header_line(line, tokens);
+            }
+        };
+
+        if (const auto c = detect_compression(path); c != compression::none) {
+            threaded_source in(open_source(path, c));
+            for_each_line(in, parse);
+        } else {
+            mapped_file file(path);
+            size_t pos = 0;
+            std::string_view line;
+            while (next_line(file.view(), pos, line)) parse(line);
+        }
+        if (!header_complete) throw std::runtime_error("no column header in " + path);
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Columns ---------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Column `C` of the schema, resolved at compile time
+     */
+    template<typename C> auto get() -> storage_t<C> &
+    {
+        static_assert(index_of<C>() < COLUMNS, "column is not part of the schema");
+        return std::get<index_of<C>()>(columns);
+    }
+
+    template<typename C> auto get() const -> const storage_t<C> &
+    {
+        static_assert(index_of<C>() < COLUMNS, "column is not part of the schema");
+        return std::get<index_of<C>()>(columns);
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return std::get<0>(columns).size(); }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Properties ------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    data_value<real> &get_property(const std::string &key) { return properties[key]; }
+
+    template<typename T> void insert_property(std::string const &key, T const &value)
+    {
+        properties.insert(std::make_pair(key, data_value<real>{ value }));
+    }
+
+    // ----------------------------------------------------------------------------------------
+    // ---- Output ----------------------------------------------------------------------------
+    // ----------------------------------------------------------------------------------------
+
+    /**
+     * @brief Writes the schema columns in schema order, in the same format as `dataframe::to_file`.
+     * Rows are formatted on the calling thread, `options.threads` does not apply.
+     */
+    void to_file(const std::string &filename, const write_options &options = {}) const
+    {
+        const auto file = open_sink(filename, options.compress);
+
+        std::string out;
+        for (auto &kvp : properties) append_property(out, kvp.first, kvp.second);
+        out.append("* ");
+        for (auto name : { Columns::name... }) {
+            append_padded(out, name, FIELDWIDTH);
+            out.push_back(' ');
+        }
+        out.append("\n$ ");
+        for (auto type : { traits_t<Columns>::type... }) {
+            append_padded(out, string_fromDT(type), FIELDWIDTH);
+            out.push_back(' ');
+        }
+        out.push_back('\n');
+        file->write(out.data(), out.size());
+
+        const size_t rows = size();
+        for (size_t begin = 0; begin < rows; begin += WRITE_BLOCK_ROWS) {
+            out.clear();
+            const size_t end = std::min(begin + WRITE_BLOCK_ROWS, rows);
+            for (size_t i = begin; i < end; i++) format_row(i, out, std::index_sequence_for<Columns...>{});
+            file->write(out.data(), out.size());
+        }
+        file->finish();
+    }
+
+  private:
+    template<typename C> static constexpr auto index_of() -> size_t
+    {
+        constexpr bool match[] = { std::is_same_v<C, Columns>... };
+        for (size_t i = 0; i < COLUMNS; i++) {
+            if (match[i]) return i;
+        }
+        return COLUMNS;
+    }
+
+    template<size_t I> using column_t = std::tuple_element_t<I, std::tuple<Columns...>>;
+
+    void read_header_line(std::string_view line, std::vector<std::string_view> &tokens)
+    {
+        if (line.empty()) return;
+
+        if (line[0] == '@') {
+            properties.insert(parse_property<real>(line, tokens));
+        } else if (line[0] == '*') {
+            tokens.clear();
+            tokenize(line, tokens);
+            file_names.assign(tokens.begin() + 1, tokens.end());
+        } else if (line[0] == '$') {
+            tokens.clear();
+            tokenize(line, tokens);
+            check_header(tokens);
+            header_complete = true;
+        }
+    }
+
+    /**
+     * @brief Matches the schema against the file columns and records how many fields to skip before
+     * each schema column. `types` is the tokenized `$` line.
+     */
+    void check_header(const std::vector<std::string_view> &types)
+    {
+        if (types.size() != file_names.size() + 1) throw std::runtime_error("column names and types differ in number");
+
+        constexpr std::array<std::string_view, COLUMNS> names = { Columns::name... };
+        constexpr std::array<DataType, COLUMNS> expected = { traits_t<Columns>::type... };
+        size_t next = 0;
+        for (size_t i = 0; i < COLUMNS; i++) {
+            const std::string name(names[i]);
+            size_t field = next;
+            while (field < file_names.size() && file_names[field] != names[i]) field++;
+            if (field == file_names.size()) {
+                for (size_t f = 0; f < next; f++) {
+                    if (file_names[f] == names[i])
+                        throw std::runtime_error("column " + name + " is out of schema order");
+                }
+                throw std::runtime_error("column " + name + " not found");
+            }
+            const auto type = types[field + 1];
+            if (type != string_fromDT(expected[i])) {
+                throw std::runtime_error("column " + name + " has type " + std::string(type) + ", schema expects "
+                                         + string_fromDT(expected[i]));
+            }
+            skips[i] = field - next;
+            next = field + 1;
+        }
+        file_names.clear();
+    }
+
+    void read_line(std::string_view line)
+    {
+        size_t pos = 0;
+        read_fields(line, pos, std::index_sequence_for<Columns...>{});
+    }
+
+    template<size_t... I> void read_fields(std::string_view line, size_t &pos, std::index_sequence<I...>)
+    {
+        (read_field<I>(line, pos), ...);
+    }
+
+    template<size_t I> void read_field(std::string_view line, size_t &pos)
+    {
+        std::string_view token;
+        for (size_t s = 0; s < skips[I]; s++) next_token(line, pos, token);
+        if (!next_token(line, pos, token)) {
+            throw std::runtime_error("row " + std::to_string(std::get<I>(columns).size()) + " has no field for column "
+                                     + std::string(column_t<I>::name));
+        }
+        traits_t<column_t<I>>::parse(std::get<I>(columns), token);
+    }
+
+    template<size_t... I> void format_row(size_t i, std::string &out, std::index_sequence<I...>) const
+    {
+        out.append("  ");
+        ((traits_t<column_t<I>>::format(std::get<I>(columns), i, out), out.push_back(' ')), ...);
+        out.push_back('\n');
+    }
+
+    std::tuple<storage_t<Columns>...> columns;
+    std::map<std::string, data_value<real>> properties;
+
+    /// number of file fields before each schema column that are not part of the schema
+    std::array<size_t, COLUMNS> skips = {};
+    /// column names of the `*` line until the `$` line has been checked
+    std::vector<std::string> file_names;
+    bool header_complete = false;
+};
+
+}// namespace tfs
@@ -1,5 +1,15 @@
+#define TFS_CPP_COUNT_ALLOCATIONS// replaces operator new to count allocations in the io_stats
 #include <gtest/gtest.h>
 #include "../src/tfs_dataframe.h"
+#include "../src/batch_reader.h"
+#include "../src/multi_loader.h"
+#include "../src/typed_dataframe.h"
+#include "../src/position_index.h"
+#include "../src/dataframe_view.h"
+#include "../src/arrow.h"
+
+#include <filesystem>
+#include <numeric>
 
 using TfsDataFrame = tfs::dataframe<double>;
 
@@ -31,3 +41,1099 @@ TEST(ReadAndWriteTest, BasicAssertions) {
     ASSERT_EQ(twiss.get_property("Q2").get_double(), 60.32);
     ASSERT_EQ(twiss.get_property("Comment").get_string(), std::string{"hello world"});
 }
+
+TEST(ReadAndWriteTest, MemoryMappedMatchesStream) {
+    TfsDataFrame twiss{};
+
+    std::vector double_column = {1.5, -2.25e-7, 3.0, 4.0e12, 5.0};
+    std::vector<std::string> string_column = {"\"BPM.1\"", "\"BPM.2\"", "three", "four", "five"};
+    std::vector<int> int_column = {1, -2, 3, 4, 5};
+
+    twiss.add_column(double_column, "doubles");
+    twiss.add_column(string_column, "strings");
+    twiss.add_column(int_column, "ints");
+    twiss.insert_property("Q1", 62.31);
+    twiss.insert_property("Comment", std::string{"hello world"});
+
+    twiss.to_file("test_mmap.tfs");
+
+    TfsDataFrame streamed{"test_mmap.tfs", "strings"};
+    TfsDataFrame mapped{"test_mmap.tfs", tfs::read_options{"strings", true}};
+
+    ASSERT_EQ(streamed.size(), mapped.size());
+    ASSERT_EQ(streamed.get_column("doubles").as_real_vector(), mapped.get_column("doubles").as_real_vector());
+    ASSERT_EQ(string_column, mapped.get_column("strings").as_string_vector());
+    ASSERT_EQ(int_column, mapped.get_column("ints").as_int_vector());
+    ASSERT_EQ(streamed.get_property("Comment").get_string(), mapped.get_property("Comment").get_string());
+    ASSERT_EQ(mapped.get_property("Q1").get_double(), 62.31);
+    ASSERT_EQ(mapped.get_index("three"), 2u);
+}
+
+TEST(ReadAndWriteTest, ParallelMatchesSequential) {
+    TfsDataFrame twiss{};
+
+    std::vector<double> double_column;
+    std::vector<std::string> string_column;
+    std::vector<int> int_column;
+    for (int i = 0; i < 20000; i++) {
+        double_column.push_back(i * 0.25);
+        string_column.push_back("BPM." + std::to_string(i));
+        int_column.push_back(i);
+    }
+
+    twiss.add_column(double_column, "doubles");
+    twiss.add_column(string_column, "strings");
+    twiss.add_column(int_column, "ints");
+    twiss.to_file("test_parallel.tfs");
+
+    tfs::read_options options;
+    options.threads = 4;
+    TfsDataFrame sequential{"test_parallel.tfs"};
+    TfsDataFrame parallel{"test_parallel.tfs", options};
+
+    ASSERT_EQ(sequential.size(), parallel.size());
+    ASSERT_EQ(sequential.get_column("doubles").as_real_vector(), parallel.get_column("doubles").as_real_vector());
+    ASSERT_EQ(string_column, parallel.get_column("strings").as_string_vector());
+    ASSERT_EQ(int_column, parallel.get_column("ints").as_int_vector());
+}
+
+TEST(ParseTest, NumbersRoundTrip) {
+    const std::vector<double> doubles = {0.0, -1.0, 62.31, 1.0 / 3.0, 6.02214076e23, -2.2250738585072014e-308};
+    for (double d : doubles) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%.17le", d);
+        ASSERT_EQ(tfs::parse_real<double>(buffer), d);
+        ASSERT_EQ(tfs::parse_real<float>(buffer), std::strtof(buffer, nullptr));
+    }
+
+    ASSERT_EQ(tfs::parse_real<double>("+1.5e+02"), 150.0);
+    ASSERT_EQ(tfs::parse_real<double>("garbage"), 0.0);
+    ASSERT_EQ(tfs::parse_int("+42"), 42);
+    ASSERT_EQ(tfs::parse_int("-7 trailing"), -7);
+
+    tfs::data_vector<float> floats(tfs::DataType::LE, "floats");
+    floats.convert_back(std::string_view("0.1 not part of the token", 3));
+    ASSERT_EQ(floats.as_real_vector()[0], 0.1f);
+}
+
+TEST(ReadAndWriteTest, ColumnProjection) {
+    TfsDataFrame twiss{};
+
+    std::vector<double> s_column = {0.0, 1.0, 2.0};
+    std::vector<double> betx_column = {10.0, 20.0, 30.0};
+    std::vector<int> int_column = {1, 2, 3};
+    std::vector<std::string> name_column = {"BPM.A", "BPM.B", "BPM.C"};
+
+    twiss.add_column(s_column, "S");
+    twiss.add_column(betx_column, "BETX");
+    twiss.add_column(int_column, "TURN");
+    twiss.add_column(name_column, "NAME");
+    twiss.to_file("test_projection.tfs");
+
+    tfs::read_options options;
+    options.index = "NAME";
+    options.columns = {"S"};
+
+    for (size_t threads : {1, 2}) {
+        options.threads = threads;
+        TfsDataFrame projected{"test_projection.tfs", options};
+
+        ASSERT_EQ(projected.size(), 3u);
+        ASSERT_EQ(projected.get_column("S").as_real_vector(), s_column);
+        ASSERT_EQ(projected.get_column("NAME").as_string_vector(), name_column);
+        ASSERT_EQ(projected.get_index("BPM.C"), 2u);
+        ASSERT_EQ(projected.get_column(0).name, "NAME");
+    }
+
+    options.columns = {"BETY"};
+    ASSERT_THROW((TfsDataFrame{"test_projection.tfs", options}), std::runtime_error);
+}
+
+TEST(BatchReaderTest, BatchesCoverAllRows) {
+    TfsDataFrame twiss{};
+
+    std::vector<double> double_column;
+    std::vector<std::string> string_column;
+    for (int i = 0; i < 1003; i++) {
+        double_column.push_back(i * 0.5);
+        string_column.push_back("BPM." + std::to_string(i));
+    }
+    twiss.add_column(double_column, "doubles");
+    twiss.add_column(string_column, "strings");
+    twiss.insert_property("Q1", 62.31);
+    twiss.to_file("test_batches.tfs");
+
+    for (bool prefetch : {false, true}) {
+        tfs::batch_reader<double> reader{"test_batches.tfs", 100, {}, prefetch};
+        ASSERT_EQ(reader.batch().get_property("Q1").get_double(), 62.31);
+
+        std::vector<double> doubles;
+        std::vector<std::string> strings;
+        size_t batches = 0;
+        while (reader.next()) {
+            auto &d = reader.batch().get_column("doubles").as_real_vector();
+            auto &s = reader.batch().get_column("strings").as_string_vector();
+            ASSERT_LE(d.size(), 100u);
+            doubles.insert(doubles.end(), d.begin(), d.end());
+            strings.insert(strings.end(), s.begin(), s.end());
+            batches++;
+        }
+
+        ASSERT_EQ(batches, 11u);
+        ASSERT_EQ(reader.rows_read(), 1003u);
+        ASSERT_EQ(doubles, double_column);
+        ASSERT_EQ(strings, string_column);
+    }
+}
+
+TEST(ReadAndWriteTest, WriterRoundTripAndParallel) {
+    TfsDataFrame twiss{};
+
+    std::vector<double> double_column;
+    std::vector<int> int_column;
+    for (int i = 0; i < 40000; i++) {
+        double_column.push_back(1.0 / (i + 3));
+        int_column.push_back(-i);
+    }
+    twiss.add_column(double_column, "doubles");
+    twiss.add_column(int_column, "ints");
+    twiss.insert_property("EX", 1.0 / 3.0);
+
+    tfs::write_options options;
+    options.threads = 3;
+    twiss.to_file("test_writer_seq.tfs");
+    twiss.to_file("test_writer_par.tfs", options);
+
+    std::ifstream seq("test_writer_seq.tfs");
+    std::ifstream par("test_writer_par.tfs");
+    std::string seq_content{std::istreambuf_iterator<char>(seq), std::istreambuf_iterator<char>()};
+    std::string par_content{std::istreambuf_iterator<char>(par), std::istreambuf_iterator<char>()};
+    ASSERT_EQ(seq_content, par_content);
+
+    TfsDataFrame twiss_read{"test_writer_par.tfs"};
+    ASSERT_EQ(twiss_read.get_column("doubles").as_real_vector(), double_column);
+    ASSERT_EQ(twiss_read.get_column("ints").as_int_vector(), int_column);
+    ASSERT_EQ(twiss_read.get_property("EX").get_double(), 1.0 / 3.0);
+}
+
+TEST(BinaryTest, SaveLoadAndSidecarCache) {
+    namespace fs = std::filesystem;
+    TfsDataFrame twiss{};
+
+    std::vector double_column = {1.0 / 3.0, 2.0, -3.5e-9};
+    std::vector<std::string> string_column = {"BPM.A", "", "a longer string that does not fit into SSO"};
+    std::vector<int> int_column = {1, -2, 3};
+
+    twiss.add_column(double_column, "doubles");
+    twiss.add_column(string_column, "strings");
+    twiss.add_column(int_column, "ints");
+    twiss.insert_property("Q1", 62.31);
+    twiss.insert_property("N", 7);
+    twiss.insert_property("Comment", std::string{"hello world"});
+
+    twiss.save_binary("test_binary.bin");
+    auto loaded = TfsDataFrame::load_binary("test_binary.bin");
+    ASSERT_EQ(loaded.get_column("doubles").as_real_vector(), double_column);
+    ASSERT_EQ(loaded.get_column("strings").as_string_vector(), string_column);
+    ASSERT_EQ(loaded.get_column("ints").as_int_vector(), int_column);
+    ASSERT_EQ(loaded.get_property("Q1").get_double(), 62.31);
+    ASSERT_EQ(loaded.get_property("N").get_int(), 7);
+    ASSERT_EQ(loaded.get_property("Comment").get_string(), "hello world");
+    ASSERT_THROW(tfs::dataframe<float>::load_binary("test_binary.bin"), std::runtime_error);
+
+    twiss.to_file("test_cached.tfs");
+    fs::remove("test_cached.tfs.bin");
+
+    tfs::read_options options;
+    options.binary_cache = true;
+    options.index = "strings";
+    TfsDataFrame first{"test_cached.tfs", options};
+    ASSERT_TRUE(fs::exists("test_cached.tfs.bin"));
+    ASSERT_EQ(first.get_column("doubles").as_real_vector(), double_column);
+
+    options.columns = {"ints"};
+    TfsDataFrame cached{"test_cached.tfs", options};
+    ASSERT_EQ(cached.get_column("ints").as_int_vector(), int_column);
+    ASSERT_EQ(cached.get_index("BPM.A"), 0u);
+    ASSERT_EQ(cached.pretty_print().find("2 columns") != std::string::npos, true);
+
+    // a sidecar that is older than the text file is rebuilt
+    std::vector<int> other_ints = {4, 5, 6};
+    twiss.get_column("ints").as_int_vector_mut() = other_ints;
+    twiss.to_file("test_cached.tfs");
+    fs::last_write_time("test_cached.tfs.bin", fs::last_write_time("test_cached.tfs") - std::chrono::seconds(10));
+    TfsDataFrame rebuilt{"test_cached.tfs", options};
+    ASSERT_EQ(rebuilt.get_column("ints").as_int_vector(), other_ints);
+}
+
+TEST(StringColumnTest, CompactStringColumns) {
+    TfsDataFrame twiss{};
+
+    std::vector<std::string> names;
+    std::vector<std::string> keywords;
+    const std::vector<std::string> kinds = {"MONITOR", "QUADRUPOLE", "SBEND", "DRIFT"};
+    for (int i = 0; i < 20000; i++) {
+        names.push_back("BPM.LONG_ELEMENT_NAME." + std::to_string(i));
+        keywords.push_back(kinds[i % kinds.size()]);
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(keywords, "KEYWORD");
+    twiss.to_file("test_compact.tfs");
+
+    tfs::read_options options;
+    options.compact_strings = true;
+    options.index = "NAME";
+    for (size_t threads : {1, 4}) {
+        options.threads = threads;
+        TfsDataFrame compact{"test_compact.tfs", options};
+
+        auto &name_col = compact.get_column("NAME").as_string_column();
+        auto &keyword_col = compact.get_column("KEYWORD").as_string_column();
+        ASSERT_FALSE(name_col.is_dictionary());
+        ASSERT_TRUE(keyword_col.is_dictionary());
+        ASSERT_EQ(keyword_col.cardinality(), kinds.size());
+        ASSERT_EQ(name_col.to_vector(), names);
+        ASSERT_EQ(keyword_col.to_vector(), keywords);
+        ASSERT_EQ(compact.get_column("KEYWORD").string_at(5), "QUADRUPOLE");
+        ASSERT_EQ(compact.get_index("BPM.LONG_ELEMENT_NAME.7"), 7u);
+        ASSERT_THROW((void)compact.get_column("NAME").as_string_vector(), std::runtime_error);
+    }
+
+    TfsDataFrame plain{"test_compact.tfs", options};
+    plain.save_binary("test_compact.bin");
+    auto loaded = TfsDataFrame::load_binary("test_compact.bin", options);
+    ASSERT_EQ(loaded.get_column("KEYWORD").as_string_column().to_vector(), keywords);
+
+    options.compact_strings = false;
+    plain.to_file("test_compact_out.tfs");
+    TfsDataFrame reread{"test_compact_out.tfs", options};
+    ASSERT_EQ(reread.get_column("NAME").as_string_vector(), names);
+}
+
+TEST(IndexTest, HashIndexAndDuplicates) {
+    TfsDataFrame twiss{};
+
+    std::vector<std::string> names = {"BPM.A", "BPM.B", "DRIFT", "BPM.C", "DRIFT"};
+    std::vector<std::string> keywords = {"MONITOR", "MONITOR", "DRIFT", "MONITOR", "DRIFT"};
+    std::vector<double> s_column = {0.0, 1.0, 2.0, 3.0, 4.0};
+    twiss.add_column(names, "NAME");
+    twiss.add_column(keywords, "KEYWORD");
+    twiss.add_column(s_column, "S");
+
+    ASSERT_TRUE(twiss.has_column("S"));
+    ASSERT_FALSE(twiss.has_column("BETX"));
+    ASSERT_THROW(twiss.get_column("BETX"), std::runtime_error);
+
+    auto &duplicates = twiss.set_index("NAME");
+    ASSERT_EQ(duplicates, std::vector<std::string>{"DRIFT"});
+    ASSERT_EQ(twiss.get_index("BPM.C"), 3u);
+    ASSERT_EQ(twiss.get_index("DRIFT"), 2u);
+    ASSERT_EQ(twiss.find_index("BPM.X"), tfs::hash_index::npos);
+    ASSERT_THROW(twiss.get_index("BPM.X"), std::runtime_error);
+
+    twiss.set_index("KEYWORD");
+    ASSERT_EQ(twiss.index_duplicates().size(), 3u);
+    ASSERT_EQ(twiss.get_index("DRIFT"), 2u);
+    ASSERT_THROW(twiss.set_index("S"), std::runtime_error);
+
+    tfs::hash_index index;
+    for (size_t i = 0; i < 1000; i++) ASSERT_TRUE(index.insert("key" + std::to_string(i), i));
+    for (size_t i = 0; i < 1000; i++) ASSERT_EQ(index.find("key" + std::to_string(i)), i);
+    index.assign("key5", 42);
+    ASSERT_EQ(index.find("key5"), 42u);
+    ASSERT_EQ(index.size(), 1000u);
+}
+
+TEST(ComplexTest, ComplexColumns) {
+    ASSERT_EQ(tfs::parse_complex<double>("1-2j"), std::complex<double>(1, -2));
+    ASSERT_EQ(tfs::parse_complex<double>("(1.5+2.5j)"), std::complex<double>(1.5, 2.5));
+    ASSERT_EQ(tfs::parse_complex<double>("-1e-5j"), std::complex<double>(0, -1e-5));
+    ASSERT_EQ(tfs::parse_complex<double>("2e+3-1e-3J"), std::complex<double>(2e3, -1e-3));
+    ASSERT_EQ(tfs::parse_complex<double>("3.25"), std::complex<double>(3.25, 0));
+    ASSERT_EQ(tfs::parse_complex<double>("-j"), std::complex<double>(0, -1));
+
+    std::vector<std::complex<double>> values = {{1.0, 0.0}, {0.0, -1.0}, {3.0, 4.0}, {-0.1, 1.0 / 3.0}};
+    TfsDataFrame df{};
+    df.add_column(values, "Z");
+    df.add_column(std::vector<double>{1.0, 2.0, 3.0, 4.0}, "S");
+    df.insert_property("TUNE", std::complex<double>(0.31, -0.002));
+
+    const std::string path = "test_complex.tfs";
+    df.to_file(path);
+    TfsDataFrame back(path);
+    ASSERT_EQ(back.get_column("Z").type, tfs::DataType::C);
+    ASSERT_EQ(back.get_column("Z").as_complex_vector().to_vector(), values);
+    ASSERT_EQ(back.get_property("TUNE").get_complex(), std::complex<double>(0.31, -0.002));
+
+    back.save_binary(path + ".bin");
+    auto binary = TfsDataFrame::load_binary(path + ".bin");
+    ASSERT_EQ(binary.get_column("Z").as_complex(2), values[2]);
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".bin");
+
+    const auto &z = back.get_column("Z").as_complex_vector();
+    auto amp = tfs::amplitude(z);
+    auto arg = tfs::phase(z);
+    auto product = tfs::conj_multiply(z, z);
+    for (size_t i = 0; i < values.size(); i++) {
+        ASSERT_DOUBLE_EQ(amp[i], std::abs(values[i]));
+        ASSERT_DOUBLE_EQ(arg[i], std::arg(values[i]));
+        ASSERT_NEAR(product.re[i], std::norm(values[i]), 1e-15);
+        ASSERT_NEAR(product.im[i], 0.0, 1e-15);
+    }
+
+    // squares of these over- and underflow
+    const std::vector<std::complex<double>> extreme = { { 3e200, -4e200 }, { 3e-200, 4e-200 }, { 0, 0 },
+        { -1e308, 1e308 }, { std::numeric_limits<double>::infinity(), 1 } };
+    tfs::split_complex<double> wide;
+    for (auto &v : extreme) wide.push_back(v);
+    const auto wide_amp = tfs::amplitude(wide);
+    for (size_t i = 0; i < extreme.size(); i++) ASSERT_DOUBLE_EQ(wide_amp[i], std::abs(extreme[i]));
+    wide.push_back({ std::nan(""), 0 });
+    ASSERT_TRUE(std::isnan(tfs::amplitude(wide).back()));
+}
+
+TEST(BoolTest, BitPackedMasks) {
+    tfs::bit_column a;
+    tfs::bit_column b;
+    for (size_t i = 0; i < 200; i++) {
+        a.push_back(i % 3 == 0);
+        b.push_back(i % 2 == 0);
+    }
+    ASSERT_EQ(a.count(), 67u);
+    ASSERT_EQ((a & b).count(), 34u);
+    ASSERT_EQ((a | b).count(), 133u);
+    ASSERT_EQ((~a).count(), 133u);
+    ASSERT_EQ((a & b).to_selection()[1], 6u);
+
+    tfs::bit_column joined = a;
+    joined.append(b);
+    ASSERT_EQ(joined.size(), 400u);
+    for (size_t i = 0; i < 200; i++) {
+        ASSERT_EQ(joined[i], a[i]);
+        ASSERT_EQ(joined[200 + i], b[i]);
+    }
+    ASSERT_EQ(tfs::bit_column(70, true).count(), 70u);
+
+    TfsDataFrame df{};
+    df.add_column(std::vector<std::string>{"BPM.A", "BPM.B", "BPM.C", "BPM.D"}, "NAME");
+    df.add_column(std::vector<double>{0.0, 1.0, 2.0, 3.0}, "S");
+    auto &faulty = df.add_column("FAULTY", tfs::DataType::B);
+    for (bool f : {false, true, false, true}) faulty.push_back(f);
+    df.insert_property("CLEANED", true);
+
+    df.to_file("test_bool.tfs");
+    TfsDataFrame back("test_bool.tfs");
+    ASSERT_EQ(back.get_column("FAULTY").as_bool_column(), df.get_column("FAULTY").as_bool_column());
+    ASSERT_TRUE(std::get<bool>(back.get_property("CLEANED").payload));
+
+    back.save_binary("test_bool.bin");
+    auto binary = TfsDataFrame::load_binary("test_bool.bin");
+    ASSERT_EQ(binary.get_column("FAULTY").as_bool_column().count(), 2u);
+
+    auto good = back.select(~back.get_column("FAULTY").as_bool_column());
+    ASSERT_EQ(good.size(), 2u);
+    ASSERT_EQ(good.get_column("S").as_real_vector(), (std::vector<double>{0.0, 2.0}));
+    ASSERT_EQ(good.get_column("NAME").string_at(1), "BPM.C");
+    ASSERT_EQ(good.get_column("FAULTY").as_bool_column().count(), 0u);
+}
+
+TEST(FilterTest, PredicatesAndSelection) {
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> s_column;
+    std::vector<double> betx;
+    std::vector<int> turns;
+    for (int i = 0; i < 1000; i++) {
+        names.push_back((i % 4 == 0 ? "BPM." : "MQ.") + std::to_string(i) + (i % 2 ? ".B1" : ".B2"));
+        s_column.push_back(0.5 * i);
+        betx.push_back(100.0 + (i % 50));
+        turns.push_back(i % 7);
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(s_column, "S");
+    twiss.add_column(betx, "BETX");
+    twiss.add_column(turns, "TURN");
+
+    auto in_range = twiss.where_between("S", 100.0, 199.5);
+    ASSERT_EQ(in_range.count(), 200u);
+    auto bpms = twiss.where_prefix("NAME", "BPM.");
+    ASSERT_EQ(bpms.count(), 250u);
+    ASSERT_EQ(twiss.where_match("NAME", "^MQ\\.[0-9]+\\.B1$").count(), 500u);
+    ASSERT_EQ(twiss.where("TURN", tfs::compare_op::eq, 3).count(), 143u);
+    ASSERT_THROW((void)twiss.where("NAME", tfs::compare_op::lt, 1.0), std::runtime_error);
+
+    auto mask = (bpms & in_range) | twiss.where("BETX", tfs::compare_op::ge, 149.0);
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < names.size(); i++) {
+        if ((i % 4 == 0 && s_column[i] >= 100.0 && s_column[i] <= 199.5) || betx[i] >= 149.0) expected.push_back(i);
+    }
+    ASSERT_EQ(mask.to_selection(), expected);
+
+    auto sequential = twiss.select(mask);
+    auto parallel = twiss.select(mask, 4);
+    ASSERT_EQ(sequential.size(), expected.size());
+    for (auto *df : {&sequential, &parallel}) {
+        for (size_t j = 0; j < expected.size(); j++) {
+            ASSERT_EQ(df->get_column("NAME").string_at(j), names[expected[j]]);
+            ASSERT_EQ(df->get_column("S").as_real_vector()[j], s_column[expected[j]]);
+            ASSERT_EQ(df->get_column("TURN").as_int_vector()[j], turns[expected[j]]);
+        }
+    }
+
+    auto &compact = twiss.get_column("NAME");
+    compact.make_compact(tfs::string_encoding::dictionary);
+    ASSERT_EQ(twiss.where_prefix("NAME", "BPM."), bpms);
+    ASSERT_EQ(twiss.select(bpms).get_column("NAME").string_at(1), names[4]);
+}
+
+TEST(JoinTest, InnerAndLeftJoin) {
+    TfsDataFrame model{};
+    model.add_column(std::vector<std::string>{"BPM.A", "BPM.B", "BPM.C", "BPM.D", "BPM.E"}, "NAME");
+    model.add_column(std::vector<double>{0.0, 1.0, 2.0, 3.0, 4.0}, "S");
+    model.add_column(std::vector<double>{10.0, 11.0, 12.0, 13.0, 14.0}, "BETX");
+    model.insert_property("Q1", 62.31);
+
+    TfsDataFrame measurement{};
+    measurement.add_column(std::vector<std::string>{"BPM.D", "BPM.A", "BPM.X", "BPM.A"}, "NAME");
+    measurement.add_column(std::vector<double>{13.5, 10.5, 99.0, 10.25}, "BETX");
+    measurement.add_column(std::vector<int>{1, 2, 3, 4}, "TURN");
+
+    // the smaller side builds the hash table, both directions keep the row order of the left frame
+    auto inner = model.join(measurement, "NAME");
+    ASSERT_EQ(inner.size(), 3u);
+    ASSERT_EQ(inner.get_column("NAME").string_at(0), "BPM.A");
+    ASSERT_EQ(inner.get_column("BETX_x").as_real_vector(), (std::vector<double>{10.0, 10.0, 13.0}));
+    ASSERT_EQ(inner.get_column("BETX_y").as_real_vector(), (std::vector<double>{10.5, 10.25, 13.5}));
+    ASSERT_EQ(inner.get_column("TURN").as_int_vector(), (std::vector<int>{2, 4, 1}));
+    ASSERT_EQ(inner.get_property("Q1").get_double(), 62.31);
+
+    auto reverse = measurement.join(model, "NAME");
+    ASSERT_EQ(reverse.get_column("S").as_real_vector(), (std::vector<double>{3.0, 0.0, 0.0}));
+    ASSERT_EQ(reverse.get_column("TURN").as_int_vector(), (std::vector<int>{1, 2, 4}));
+
+    tfs::join_options options;
+    options.how = tfs::join_type::left;
+    options.left_suffix = "_MODEL";
+    options.right_suffix = "_MEAS";
+    options.threads = 2;
+    auto left = model.join(measurement, "NAME", options);
+    ASSERT_EQ(left.size(), 6u);
+    ASSERT_EQ(left.get_column("S").as_real_vector(), (std::vector<double>{0.0, 0.0, 1.0, 2.0, 3.0, 4.0}));
+    ASSERT_EQ(left.get_column("TURN").as_int_vector(), (std::vector<int>{2, 4, 0, 0, 1, 0}));
+    ASSERT_TRUE(std::isnan(left.get_column("BETX_MEAS").as_real_vector()[2]));
+    ASSERT_EQ(left.get_column("BETX_MODEL").as_real_vector()[5], 14.0);
+
+    auto left_small = measurement.join(model, "NAME", options);
+    ASSERT_EQ(left_small.size(), 4u);
+    ASSERT_EQ(left_small.get_column("NAME").string_at(2), "BPM.X");
+    ASSERT_TRUE(std::isnan(left_small.get_column("S").as_real_vector()[2]));
+    ASSERT_EQ(left_small.get_column("S").as_real_vector()[3], 0.0);
+
+    ASSERT_THROW((void)model.join(measurement, "S"), std::runtime_error);
+}
+
+TEST(RefreshTest, AppendedRowsAndRewrites) {
+    const std::string path = "test_refresh.tfs";
+    const std::string header = "@ NAME %s \"TRACK\"\n* NAME TURN X\n$ %s %d %le\n";
+    auto append = [&path](const std::string &text) {
+        std::ofstream f(path, std::ios::app | std::ios::binary);
+        f << text;
+    };
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << header << " P0 1 0.5\n P1 1 0.25\n";
+    }
+
+    for (bool memory_map : {false, true}) {
+        tfs::read_options options;
+        options.index = "NAME";
+        options.memory_map = memory_map;
+        TfsDataFrame df(path, options);
+        ASSERT_EQ(df.size(), 2u);
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::unchanged);
+
+        append(" P2 2 0.125\n P3 2 0.0625\n P4 3 0.03");
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::appended);
+        ASSERT_EQ(df.size(), 4u);
+        ASSERT_EQ(df.get_index("P3"), 3u);
+        ASSERT_EQ(df.get_column("X").as_real_vector()[2], 0.125);
+
+        append("125\n");
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::appended);
+        ASSERT_EQ(df.size(), 5u);
+        ASSERT_EQ(df.get_column("X").as_real_vector()[4], 0.03125);
+        ASSERT_EQ(df.get_index("P4"), 4u);
+
+        {
+            std::ofstream f(path, std::ios::binary);
+            f << header << " Q0 7 1.5\n";
+        }
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::reloaded);
+        ASSERT_EQ(df.size(), 1u);
+        ASSERT_EQ(df.get_index("Q0"), 0u);
+
+        {
+            std::ofstream f(path, std::ios::binary);
+            f << header << " P0 1 0.5\n P1 1 0.25\n";
+        }
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::reloaded);
+        ASSERT_EQ(df.size(), 2u);
+    }
+
+    TfsDataFrame built{};
+    ASSERT_THROW(built.refresh(), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(MultiLoaderTest, LoadsFilesConcurrently) {
+    std::vector<tfs::load_request> requests;
+    for (int f = 0; f < 6; f++) {
+        TfsDataFrame df{};
+        std::vector<std::string> names;
+        std::vector<double> betx;
+        for (int i = 0; i < 100 * (f + 1); i++) {
+            names.push_back("BPM." + std::to_string(i));
+            betx.push_back(f + 0.5 * i);
+        }
+        df.add_column(names, "NAME");
+        df.add_column(betx, "BETX");
+        df.add_column(betx, "BETY");
+        const std::string path = "test_multi_" + std::to_string(f) + ".tfs";
+        df.to_file(path);
+        requests.push_back({ path });
+    }
+    requests[2].options.columns = {"BETX"};
+    requests[3].options.index = "NAME";
+    requests.push_back({ "test_multi_missing.tfs" });
+
+    tfs::load_options options;
+    options.threads = 3;
+    options.prefetch = 2;
+    auto results = tfs::load_files<double>(requests, options);
+    ASSERT_EQ(results.size(), 7u);
+    for (int f = 0; f < 6; f++) {
+        ASSERT_TRUE(results[f].ok()) << results[f].error;
+        ASSERT_EQ(results[f].path, requests[f].path);
+        ASSERT_EQ(results[f].df.size(), 100u * (f + 1));
+        ASSERT_EQ(results[f].df.get_column("BETX").as_real_vector()[3], f + 1.5);
+    }
+    ASSERT_FALSE(results[2].df.has_column("BETY"));
+    ASSERT_EQ(results[3].df.get_index("BPM.42"), 42u);
+    ASSERT_FALSE(results[6].ok());
+    ASSERT_FALSE(results[6].error.empty());
+
+    std::vector<std::string> paths;
+    for (int f = 0; f < 2; f++) paths.push_back(requests[f].path);
+    tfs::read_options parallel;
+    parallel.threads = 0;
+    auto few = tfs::load_files<double>(paths, parallel);
+    ASSERT_EQ(few[1].df.size(), 200u);
+    for (int f = 0; f < 6; f++) std::filesystem::remove(requests[f].path);
+}
+
+TEST(CompressionTest, GzipRoundTrip) {
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> betx;
+    for (int i = 0; i < 100000; i++) {
+        names.push_back("\"BPM." + std::to_string(i) + "\"");
+        betx.push_back(100.0 + 1.0 / (i + 1));
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(betx, "BETX");
+    twiss.insert_property("Q1", 62.31);
+    twiss.to_file("test_compressed.tfs");
+
+#if defined(TFS_CPP_ZLIB)
+    tfs::write_options options;
+    options.threads = 2;
+    twiss.to_file("test_compressed.tfs.gz", options);
+    ASSERT_EQ(tfs::detect_compression("test_compressed.tfs.gz"), tfs::compression::gzip);
+    ASSERT_LT(std::filesystem::file_size("test_compressed.tfs.gz"), std::filesystem::file_size("test_compressed.tfs"));
+
+    TfsDataFrame plain("test_compressed.tfs", "NAME");
+    TfsDataFrame compressed("test_compressed.tfs.gz", "NAME");
+    ASSERT_EQ(compressed.size(), plain.size());
+    ASSERT_EQ(compressed.get_column("BETX").as_real_vector(), plain.get_column("BETX").as_real_vector());
+    ASSERT_EQ(compressed.get_index("\"BPM.77777\""), 77777u);
+    ASSERT_EQ(compressed.get_property("Q1").get_double(), 62.31);
+
+    options.compress = tfs::compression::gzip;
+    twiss.to_file("test_compressed_named.tfs", options);
+    tfs::read_options projection;
+    projection.columns = {"BETX"};
+    ASSERT_EQ(TfsDataFrame("test_compressed_named.tfs", projection).get_column("BETX").as_real_vector(), betx);
+
+    // a file cut inside the stream is an error, not a shorter table
+    const auto size = std::filesystem::file_size("test_compressed.tfs.gz");
+    std::filesystem::resize_file("test_compressed.tfs.gz", size / 2);
+    ASSERT_THROW(TfsDataFrame("test_compressed.tfs.gz"), std::runtime_error);
+    std::filesystem::remove("test_compressed.tfs.gz");
+    std::filesystem::remove("test_compressed_named.tfs");
+#else
+    ASSERT_THROW(twiss.to_file("test_compressed.tfs.gz"), std::runtime_error);
+#endif
+    std::filesystem::remove("test_compressed.tfs");
+}
+
+TEST(CompressionTest, ZstdRoundTrip) {
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> betx;
+    for (int i = 0; i < 100000; i++) {
+        names.push_back("\"BPM." + std::to_string(i) + "\"");
+        betx.push_back(100.0 + 1.0 / (i + 1));
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(betx, "BETX");
+    twiss.insert_property("Q1", 62.31);
+
+#if defined(TFS_CPP_ZSTD)
+    tfs::write_options options;
+    options.threads = 2;
+    twiss.to_file("test_compressed.tfs.zst", options);
+    ASSERT_EQ(tfs::detect_compression("test_compressed.tfs.zst"), tfs::compression::zstd);
+
+    TfsDataFrame compressed("test_compressed.tfs.zst", "NAME");
+    ASSERT_EQ(compressed.size(), twiss.size());
+    ASSERT_EQ(compressed.get_column("BETX").as_real_vector(), betx);
+    ASSERT_EQ(compressed.get_index("\"BPM.77777\""), 77777u);
+    ASSERT_EQ(compressed.get_property("Q1").get_double(), 62.31);
+
+    // a file cut inside the frame is an error, not a shorter table
+    const auto size = std::filesystem::file_size("test_compressed.tfs.zst");
+    std::filesystem::resize_file("test_compressed.tfs.zst", size / 2);
+    ASSERT_THROW(TfsDataFrame("test_compressed.tfs.zst"), std::runtime_error);
+    std::filesystem::remove("test_compressed.tfs.zst");
+#else
+    ASSERT_THROW(twiss.to_file("test_compressed.tfs.zst"), std::runtime_error);
+#endif
+}
+
+namespace twiss_columns {
+TFS_COLUMN(BETX, real_field);
+TFS_COLUMN(NAME, string_field);
+TFS_COLUMN(S, real_field);
+TFS_COLUMN(TURN, int_field);
+struct TURN_AS_REAL : tfs::real_field {
+    static constexpr std::string_view name = "TURN";
+};
+}// namespace twiss_columns
+
+TEST(TypedDataFrameTest, SchemaRoundTripAndValidation) {
+    using namespace twiss_columns;
+    TfsDataFrame twiss{};
+    // full-width values, so that cells only stay apart through their separators
+    std::vector<std::string> names = {"\"BPM.1\"", "\"A.VERY.LONG.ELEMENT.NAME\"", "\"BPM.3\""};
+    std::vector<double> betx = {101.5, 1.0 / 3, -1.0 / 3e-300};
+    std::vector<double> s = {0.0, 12.5, 25.0};
+    std::vector<int> turn = {1, 2, 3};
+    twiss.add_column(betx, "BETX");
+    twiss.add_column(names, "NAME");
+    twiss.add_column(s, "S");
+    twiss.add_column(turn, "TURN");
+    twiss.insert_property("Q1", 62.31);
+    twiss.to_file("test_typed.tfs");
+
+    // TURN is in the file but not in the schema, it is skipped
+    using twiss_schema = tfs::schema<BETX, NAME, S>;
+    tfs::typed_dataframe<twiss_schema> typed("test_typed.tfs");
+    ASSERT_EQ(typed.size(), 3u);
+    ASSERT_EQ(typed.get<BETX>(), betx);
+    ASSERT_EQ(typed.get<NAME>(), names);
+    ASSERT_EQ(typed.get<S>(), s);
+    ASSERT_EQ(typed.get_property("Q1").get_double(), 62.31);
+
+    typed.get<BETX>()[0] = 42.0;
+    betx[0] = 42.0;
+    typed.to_file("test_typed_out.tfs");
+    TfsDataFrame written("test_typed_out.tfs");
+    ASSERT_EQ(written.get_column("BETX").as_real_vector(), betx);
+    ASSERT_EQ(written.get_column("NAME").as_string_vector(), names);
+    ASSERT_FALSE(written.has_column("TURN"));
+    tfs::typed_dataframe<twiss_schema> reread("test_typed_out.tfs");
+    ASSERT_EQ(reread.get<BETX>(), betx);
+    ASSERT_EQ(reread.get<NAME>(), names);
+    ASSERT_EQ(reread.get<S>(), s);
+
+    // wrong order, missing column and wrong type
+    using reversed = tfs::schema<S, BETX>;
+    ASSERT_THROW(tfs::typed_dataframe<reversed>("test_typed.tfs"), std::runtime_error);
+    ASSERT_THROW(tfs::typed_dataframe<tfs::schema<TURN>>("test_typed_out.tfs"), std::runtime_error);
+    ASSERT_THROW(tfs::typed_dataframe<tfs::schema<TURN_AS_REAL>>("test_typed.tfs"), std::runtime_error);
+
+    std::filesystem::remove("test_typed.tfs");
+    std::filesystem::remove("test_typed_out.tfs");
+}
+
+TEST(StatsTest, ReadAndWriteStatistics) {
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> betx;
+    std::vector<int> turn;
+    for (int i = 0; i < 1000; i++) {
+        names.push_back("\"BPM." + std::to_string(i) + "\"");
+        betx.push_back(100.0 + i);
+        turn.push_back(i);
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(betx, "BETX");
+    twiss.add_column(turn, "TURN");
+
+    tfs::io_stats written;
+    tfs::write_options write;
+    write.stats = &written;
+    twiss.to_file("test_stats.tfs", write);
+    ASSERT_EQ(written.rows, 1000u);
+    ASSERT_EQ(written.cells, 3000u);
+    ASSERT_EQ(written.bytes, std::filesystem::file_size("test_stats.tfs"));
+    ASSERT_EQ(written.columns.size(), 3u);
+    ASSERT_GT(written.allocations, 0u);
+
+    for (size_t threads : {1, 2}) {
+        tfs::io_stats stats;
+        tfs::read_options options;
+        options.threads = threads;
+        options.columns = {"BETX", "NAME"};
+        options.stats = &stats;
+        TfsDataFrame df("test_stats.tfs", options);
+        ASSERT_EQ(stats.rows, 1000u);
+        ASSERT_EQ(stats.cells, 2000u);
+        ASSERT_EQ(stats.bytes, written.bytes);
+        ASSERT_GT(stats.header_seconds, 0.0);
+        ASSERT_GT(stats.body_seconds, 0.0);
+        ASSERT_GT(stats.rows_per_second(), 0.0);
+        ASSERT_GT(stats.allocations, 0u);
+        ASSERT_GE(stats.allocated_bytes, stats.columns[0].memory_bytes);
+        ASSERT_EQ(stats.columns.size(), 2u);
+        for (auto &c : stats.columns) {
+            ASSERT_EQ(c.memory_bytes, df.get_column(c.name).memory_usage());
+            ASSERT_GT(c.seconds, 0.0);
+        }
+        // refresh must not write to the statistics of the original read any more
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::unchanged);
+    }
+
+    auto results = tfs::load_files<double>({"test_stats.tfs"}, {}, tfs::load_options{1, 0, true});
+    ASSERT_EQ(results[0].stats.rows, 1000u);
+    std::filesystem::remove("test_stats.tfs");
+}
+
+/// memory resource counting what is allocated from it
+class counting_resource : public std::pmr::memory_resource {
+  public:
+    size_t allocations = 0;
+
+  private:
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        allocations++;
+        return arena.allocate(bytes, alignment);
+    }
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    std::pmr::monotonic_buffer_resource arena;
+};
+
+TEST(PmrTest, ColumnsAllocateFromResource) {
+    static_assert(std::is_same_v<decltype(TfsDataFrame().get_column(0).as_real_vector()), const std::vector<double> &>);
+
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> betx;
+    for (int i = 0; i < 1000; i++) {
+        names.push_back("\"BEAM_POSITION_MONITOR." + std::to_string(i) + "\"");
+        betx.push_back(100.0 + i);
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(betx, "BETX");
+    twiss.to_file("test_pmr.tfs");
+
+    counting_resource arena;
+    for (size_t threads : {1, 2}) {
+        const size_t before = arena.allocations;
+        tfs::read_options options;
+        options.index = "NAME";
+        options.threads = threads;
+        tfs::pmr::dataframe<double> df("test_pmr.tfs", options, &arena);
+        // every name is longer than the small string buffer
+        ASSERT_GT(arena.allocations - before, names.size());
+        ASSERT_EQ(df.get_column("BETX").as_real_vector().get_allocator().resource(), &arena);
+        ASSERT_EQ(df.get_column("NAME").string_at(7), names[7]);
+        ASSERT_EQ(df.get_index(names[7]), 7u);
+
+        auto selected = df.select(df.where("BETX", tfs::compare_op::ge, 1000.0));
+        ASSERT_EQ(selected.size(), 100u);
+        ASSERT_EQ(selected.get_column("BETX").as_real_vector().get_allocator().resource(), &arena);
+        ASSERT_EQ(df.refresh(), tfs::refresh_status::unchanged);
+    }
+    std::filesystem::remove("test_pmr.tfs");
+}
+
+TEST(AggregateTest, SummariesAndGroups) {
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> beating;
+    std::vector<int> turn;
+    const size_t n = 200000;
+    for (size_t i = 0; i < n; i++) {
+        names.push_back(i % 4 == 0 ? "\"IP" + std::to_string(i) + "\"" : "\"ARC" + std::to_string(i) + "\"");
+        // large offset, small spread: naive summation of squares would lose the variance
+        beating.push_back(1.0e8 + (i % 2 == 0 ? 0.5 : -0.5));
+        turn.push_back(static_cast<int>(i % 3));
+    }
+    beating[10] = std::numeric_limits<double>::quiet_NaN();
+    twiss.add_column(names, "NAME");
+    twiss.add_column(beating, "BEAT");
+    twiss.add_column(turn, "TURN");
+
+    const auto serial = twiss.summarize("BEAT");
+    for (size_t threads : {1, 4}) {
+        auto s = twiss.summarize("BEAT", threads);
+        ASSERT_EQ(s.sum, serial.sum);// blocks merge in the same order for any number of threads
+        ASSERT_EQ(s.m2, serial.m2);
+        ASSERT_EQ(s.count, n - 1);
+        ASSERT_DOUBLE_EQ(s.min, 1.0e8 - 0.5);
+        ASSERT_DOUBLE_EQ(s.max, 1.0e8 + 0.5);
+        ASSERT_NEAR(s.mean, 1.0e8 - 0.5 / (n - 1), 1e-7);// the NaN replaced a +0.5
+        ASSERT_NEAR(s.stddev(), 0.5 * std::sqrt((n - 1.0) / (n - 2.0)), 1e-6);// sample deviation
+        ASSERT_NEAR(s.rms(), s.mean, 1e-6);
+
+        auto both = twiss.summarize({ "BEAT", "TURN" }, threads);
+        ASSERT_EQ(both[1].count, n);
+        ASSERT_EQ(both[1].sum, static_cast<double>(std::accumulate(turn.begin(), turn.end(), 0LL)));
+        ASSERT_EQ(both[0].mean, s.mean);
+
+        auto by_turn = twiss.summarize_by("TURN", {"BEAT"}, threads);
+        ASSERT_EQ(by_turn.keys, (std::vector<std::string>{"0", "1", "2"}));
+        ASSERT_EQ(by_turn.at(1, 0).count, n / 3);
+
+        auto by_prefix = twiss.summarize_by(
+            "NAME", [](std::string_view name) { return name.substr(0, 3); }, {"BEAT", "TURN"}, threads);
+        ASSERT_EQ(by_prefix.keys, (std::vector<std::string>{"\"IP", "\"AR"}));
+        ASSERT_EQ(by_prefix.at(0, 0).count, n / 4);
+        ASSERT_DOUBLE_EQ(by_prefix.at(0, 0).max, 1.0e8 + 0.5);
+        ASSERT_DOUBLE_EQ(by_prefix.at(0, 0).stddev(), 0.0);// every 4th row is +0.5
+        ASSERT_NEAR(by_prefix.at(1, 0).stddev(), std::sqrt(2.0) / 3.0, 1e-5);
+        ASSERT_EQ(by_prefix.at(0, 1).count + by_prefix.at(1, 1).count, n);
+    }
+    ASSERT_THROW((void)twiss.summarize("NAME"), std::runtime_error);
+}
+
+TEST(ExpressionTest, FusedColumnExpressions) {
+    const size_t n = 100000;
+    TfsDataFrame model{};
+    std::vector<double> betx(n);
+    std::vector<double> measured(n);
+    std::vector<int> turn(n);
+    for (size_t i = 0; i < n; i++) {
+        betx[i] = 10.0 + static_cast<double>(i % 100);
+        measured[i] = betx[i] * (1.0 + 0.001 * static_cast<double>(i % 7));
+        turn[i] = static_cast<int>(i % 5);
+    }
+    model.add_column(betx, "BETX");
+    model.add_column(measured, "BETX_MEAS");
+    model.add_column(turn, "TURN");
+
+    const auto beating = (model.expr("BETX_MEAS") - model.expr("BETX")) / model.expr("BETX");
+    model.add_column(beating, "BEATING", 0);
+    model.add_column(tfs::sqrt(model.expr("BETX") * 2.5e-9) + model.int_expr("TURN"), "SIGMA");
+    model.add_column(-tfs::pow(model.expr("BETX"), 2) * 0.5 + 1.0, "PARABOLA");
+
+    const auto &b = model.get_column("BEATING").as_real_vector();
+    const auto &sigma = model.get_column("SIGMA").as_real_vector();
+    const auto &parabola = model.get_column("PARABOLA").as_real_vector();
+    ASSERT_EQ(b.size(), n);
+    for (size_t i : {size_t{ 0 }, size_t{ 3 }, size_t{ 65536 }, n - 1}) {
+        ASSERT_EQ(b[i], (measured[i] - betx[i]) / betx[i]);
+        ASSERT_EQ(sigma[i], std::sqrt(betx[i] * 2.5e-9) + turn[i]);
+        ASSERT_EQ(parabola[i], -std::pow(betx[i], 2) * 0.5 + 1.0);
+    }
+    ASSERT_EQ(tfs::evaluate(beating), b);// same values on one and on all threads
+
+    // %d operands keep integer arithmetic
+    ASSERT_EQ(tfs::evaluate(model.int_expr("TURN") / 2)[3], 1.0);
+
+    const std::vector<double> shorter(10, 1.0);
+    ASSERT_THROW(model.expr("BETX") + tfs::column_expr(shorter), std::runtime_error);
+    ASSERT_THROW((void)model.expr("TURN"), std::runtime_error);
+}
+
+TEST(PositionIndexTest, LookupsAndInterpolation) {
+    // element ends with zero length markers sharing a position
+    std::vector<double> s;
+    std::vector<double> betx;
+    std::vector<int> turn;
+    for (size_t i = 0; i < 5000; i++) {
+        s.push_back(static_cast<double>(i / 2) * 1.5);
+        betx.push_back(100.0 + static_cast<double>(i));
+        turn.push_back(static_cast<int>(i));
+    }
+    TfsDataFrame twiss{};
+    twiss.add_column(s, "S");
+    twiss.add_column(betx, "BETX");
+    twiss.add_column(turn, "TURN");
+
+    const tfs::position_index<double> index(twiss.get_column("S"));
+    ASSERT_EQ(index.size(), s.size());
+
+    std::vector<double> queries = { -1.0, 0.0, 0.75, 1.5, 2.0, s.back(), s.back() + 1.0 };
+    for (size_t i = 0; i < 3000; i++) queries.push_back(static_cast<double>((i * 7919) % 4000) * 0.9);
+    const auto found = index.lower_bound(queries);
+    for (size_t q = 0; q < queries.size(); q++) {
+        ASSERT_EQ(found[q], static_cast<size_t>(std::lower_bound(s.begin(), s.end(), queries[q]) - s.begin()));
+        ASSERT_EQ(index.upper_bound(queries[q]),
+            static_cast<size_t>(std::upper_bound(s.begin(), s.end(), queries[q]) - s.begin()));
+    }
+    ASSERT_EQ(index.range(1.5, 3.0), std::make_pair(size_t{ 2 }, size_t{ 6 }));
+    ASSERT_EQ(index.range({ { 10.0, 5.0 } })[0].first, index.range({ { 10.0, 5.0 } })[0].second);
+
+    const auto beta = index.interpolate(twiss.get_column("BETX"), { 0.75, 1.5, -3.0, 1.0e6 });
+    ASSERT_DOUBLE_EQ(beta[0], 101.5);// between rows 1 (S=0) and 2 (S=1.5)
+    ASSERT_DOUBLE_EQ(beta[1], 102.0);// first of the rows at 1.5
+    ASSERT_DOUBLE_EQ(beta[2], 100.0);
+    ASSERT_DOUBLE_EQ(beta[3], betx.back());
+    ASSERT_DOUBLE_EQ(index.interpolate(twiss.get_column("TURN"), 2.25), 3.5);// rows 3 (S=1.5) and 4 (S=3)
+    ASSERT_TRUE(std::isnan(index.interpolate(twiss.get_column("BETX"), std::nan(""))));
+
+    std::vector<double> unsorted = s;
+    std::swap(unsorted[10], unsorted[20]);
+    twiss.add_column(unsorted, "X");
+    ASSERT_THROW(tfs::position_index<double>{ twiss.get_column("X") }, std::runtime_error);
+}
+
+TEST(DataFrameViewTest, RowRangesAndColumnSubsets) {
+    TfsDataFrame twiss{};
+    std::vector<std::string> names;
+    std::vector<double> s;
+    std::vector<double> betx;
+    std::vector<int> turn;
+    for (size_t i = 0; i < 1000; i++) {
+        names.push_back("\"BPM" + std::to_string(i) + "\"");
+        s.push_back(static_cast<double>(i) * 0.5);
+        betx.push_back(static_cast<double>(i % 10));
+        turn.push_back(static_cast<int>(i));
+    }
+    twiss.add_column(names, "NAME");
+    twiss.add_column(s, "S");
+    twiss.add_column(betx, "BETX");
+    twiss.add_column(turn, "TURN");
+    twiss.insert_property("Q1", 62.31);
+    twiss.set_index("NAME");
+
+    const tfs::dataframe_view sector(twiss, { 100, 300 });
+    ASSERT_EQ(sector.size(), 200);
+    ASSERT_EQ(sector.column_names(), (std::vector<std::string>{ "BETX", "NAME", "S", "TURN" }));
+
+    // spans point into the dataframe
+    const auto span = sector.get_column("S").as_real_span();
+    ASSERT_EQ(span.data(), twiss.get_column("S").as_real_vector().data() + 100);
+    ASSERT_EQ(sector.get_column("NAME").string_at(0), "\"BPM100\"");
+
+    ASSERT_EQ(sector.get_index("\"BPM150\""), 50);
+    ASSERT_EQ(sector.find_index("\"BPM50\""), tfs::hash_index::npos);
+    ASSERT_THROW((void)sector.get_index("\"BPM300\""), std::runtime_error);
+
+    const auto stats = sector.summarize({ "BETX", "TURN" });
+    ASSERT_EQ(stats[0].count, 200);
+    ASSERT_DOUBLE_EQ(stats[0].mean, 4.5);
+    ASSERT_DOUBLE_EQ(stats[1].min, 100.0);
+    ASSERT_DOUBLE_EQ(stats[1].max, 299.0);
+    const auto by_name = sector.slice(0, 20).summarize_by("NAME", [](std::string_view n) { return n.substr(0, 6); },
+        { "TURN" });
+    ASSERT_EQ(by_name.keys, (std::vector<std::string>{ "\"BPM10", "\"BPM11" }));
+    ASSERT_DOUBLE_EQ(by_name.at(1, 0).mean, 114.5);
+
+    const auto half = tfs::evaluate(sector.expr("S") * 2.0);
+    ASSERT_EQ(half.front(), 100.0);
+
+    // a column subset of a sub-range writes the same file as its copy
+    const auto subset = sector.slice(10, 20).select({ "S", "NAME" });
+    ASSERT_THROW((void)subset.select({ "BETX" }), std::runtime_error);
+    ASSERT_THROW((void)subset.get_column("TURN"), std::runtime_error);
+    const auto copy = subset.materialize();
+    ASSERT_EQ(copy.size(), 10);
+    ASSERT_FALSE(copy.has_column("BETX"));
+    ASSERT_EQ(copy.get_column("S").as_real_vector().front(), 55.0);
+
+    subset.to_file("test_view.tfs");
+    copy.to_file("test_view_copy.tfs");
+    std::ifstream view_file("test_view.tfs");
+    std::ifstream copy_file("test_view_copy.tfs");
+    std::stringstream view_text;
+    std::stringstream copy_text;
+    view_text << view_file.rdbuf();
+    copy_text << copy_file.rdbuf();
+    ASSERT_EQ(view_text.str(), copy_text.str());
+
+    TfsDataFrame reread("test_view.tfs");
+    ASSERT_EQ(reread.size(), 10);
+    ASSERT_DOUBLE_EQ(reread.get_property("Q1").get_double(), 62.31);
+    ASSERT_EQ(reread.get_column("NAME").string_at(9), "\"BPM119\"");
+}
+
+TEST(ArrowTest, ExportAndImport) {
+    auto twiss = std::make_shared<TfsDataFrame>();
+    twiss->add_column(std::vector<std::string>{ "\"BPM1\"", "\"BPM2\"", "\"MQ.3\"" }, "NAME");
+    twiss->add_column(std::vector<double>{ 0.5, 1.5, 2.5 }, "S");
+    twiss->add_column(std::vector<int>{ 1, 2, 3 }, "TURN");
+    twiss->add_column(std::vector<std::complex<double>>{ { 1, 2 }, { 3, 4 }, { 5, 6 } }, "Z");
+    auto &faulty = twiss->add_column("FAULTY", tfs::DataType::B);
+    for (bool b : { true, false, true }) faulty.push_back(b);
+    twiss->insert_property("Q1", 62.31);
+    twiss->insert_property("NTURNS", 1000);
+    twiss->insert_property("SEQUENCE", std::string{ "\"LHCB1\"" });
+    twiss->insert_property("ENERGY", 6800.0);// written as 6800, still %le after the import
+    twiss->insert_property("RUN", std::string{ "\"42\"" });
+
+    ArrowSchema schema;
+    ArrowArray array;
+    tfs::export_arrow(std::shared_ptr<const TfsDataFrame>(twiss), &schema, &array);
+    ASSERT_EQ(std::string(schema.format), "+s");
+    ASSERT_EQ(schema.n_children, 5);
+    ASSERT_EQ(array.length, 3);
+
+    // children in file order: FAULTY, NAME, S, TURN, Z
+    ASSERT_EQ(std::string(schema.children[2]->name), "S");
+    ASSERT_EQ(std::string(schema.children[2]->format), "g");
+    ASSERT_EQ(array.children[2]->buffers[1], twiss->get_column("S").as_real_vector().data());// shared
+    ASSERT_EQ(array.children[3]->buffers[1], twiss->get_column("TURN").as_int_vector().data());
+    ASSERT_EQ(std::string(schema.children[1]->format), "u");
+    const auto *offsets = static_cast<const int32_t *>(array.children[1]->buffers[1]);
+    const auto *text = static_cast<const char *>(array.children[1]->buffers[2]);
+    ASSERT_EQ(std::string(text + offsets[2], offsets[3] - offsets[2]), "MQ.3");// without quotes
+    ASSERT_EQ(std::string(schema.children[4]->format), "+s");
+
+    // a consumer may move a child out and release it after the rest
+    ArrowArray s_column = *array.children[2];
+    array.children[2]->release = nullptr;
+    ASSERT_GT(twiss.use_count(), 2);
+    array.release(&array);
+    schema.release(&schema);
+    ASSERT_EQ(twiss.use_count(), 2);// only S is still held
+    s_column.release(&s_column);
+    ASSERT_EQ(twiss.use_count(), 1);
+
+    tfs::export_arrow(std::shared_ptr<const TfsDataFrame>(twiss), &schema, &array);
+    const auto imported = tfs::import_arrow(&schema, &array);
+    ASSERT_EQ(schema.release, nullptr);
+    ASSERT_EQ(array.release, nullptr);
+    ASSERT_EQ(twiss.use_count(), 1);
+
+    ASSERT_EQ(imported.size(), 3);
+    ASSERT_EQ(imported.get_column("S").as_real_vector(), twiss->get_column("S").as_real_vector());
+    ASSERT_EQ(imported.get_column("NAME").string_at(2), "\"MQ.3\"");
+    ASSERT_EQ(imported.get_column("TURN").as_int_vector(), (std::vector<int>{ 1, 2, 3 }));
+    ASSERT_EQ(imported.get_column("Z").as_complex(1), std::complex<double>(3, 4));
+    ASSERT_TRUE(imported.get_column("FAULTY").as_bool_column()[2]);
+    ASSERT_FALSE(imported.get_column("FAULTY").as_bool_column()[1]);
+    auto &properties = imported.get_properties();
+    ASSERT_DOUBLE_EQ(properties.at("Q1").get_double(), 62.31);
+    ASSERT_EQ(properties.at("NTURNS").get_int(), 1000);
+    ASSERT_EQ(properties.at("SEQUENCE").pretty_print(), "\"LHCB1\"");
+    ASSERT_EQ(properties.at("ENERGY").get_double(), 6800.0);
+    ASSERT_EQ(properties.at("RUN").type, tfs::DataType::S);
+    ASSERT_EQ(properties.at("RUN").pretty_print(), "\"42\"");
+    ASSERT_EQ(properties.size(), 5);
+}